@@ -20,6 +20,8 @@
 #include <glm/gtc/type_ptr.hpp>
 #include <cstdlib>
 #include "Mesh.h"
+#include "AssetLoader.h"
+#include "CollisionWorld.h"
 
 // Maximum no of frames processed concurrently
 const int MAX_FRAMES_IN_FLIGHT = 2;
@@ -70,13 +72,17 @@ class Application
 {
 private:
 
-	// Mesh loaded
-	Mesh ball;
+	// Meshes of the scene, drawn once they are uploaded
+	std::vector<Mesh*> meshes;
 
-	Mesh ball2;
+	// Loader parsing the meshes in the background
+	AssetLoader *assetLoader;
 
 	Window window;
 
+	// Collision world of the meshes
+	CollisionWorld *collisionWorld;
+
 	// Vulkan Instance - Connection between the application and the Vulkan Library
 	VkInstance instance;
 
@@ -156,6 +162,9 @@ public:
 	// Main Loop functions that is run in every frame
 	void mainLoop();
 
+	// Function to upload the meshes loaded in the background
+	void uploadLoadedMeshes();
+
 	// Cleanup function to destroy all elements
 	void cleanup();
 	
@@ -0,0 +1,67 @@
+#pragma once
+#include <string>
+#include <deque>
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <exception>
+#include "Mesh.h"
+
+class CollisionWorld;
+
+// Number of worker threads used when none is given, a zero hardware thread count falls back to this
+const int DEFAULT_ASSET_LOADER_THREADS = 2;
+
+// Mesh waiting to be loaded or uploaded
+struct AssetRequest
+{
+	Mesh *mesh;
+	std::string filename;
+	CollisionWorld *collisionWorld;
+
+	// Error thrown by the worker, rethrown on the render thread
+	std::exception_ptr error;
+};
+
+// Loads meshes in the background so that objects appear as they become ready instead of stalling startup
+// Worker threads parse the model files and build the collision bodies, the render thread then uploads the finished
+// meshes to the device within a time budget per frame, since only it may record and submit the transfers
+class AssetLoader
+{
+private:
+	std::vector<std::thread> workers;
+
+	// Requests waiting for a worker and requests loaded and waiting for the upload
+	std::deque<AssetRequest> pendingRequests;
+	std::deque<AssetRequest> loadedRequests;
+
+	// Number of requests taken by a worker and not yet loaded
+	int activeCount;
+	bool isStopping;
+
+	std::mutex requestsMutex;
+	std::condition_variable requestsCondition;
+
+	// Function run by every worker thread
+	void WorkerLoop();
+
+public:
+	// A thread count of zero uses every hardware thread but the render thread
+	AssetLoader(int threadCount = 0);
+	~AssetLoader();
+
+	// Function to queue a mesh made with the deferred constructor, the mesh must outlive the loader or the upload
+	void LoadMesh(Mesh *mesh, std::string filename, CollisionWorld *collisionWorld);
+
+	// Function to upload loaded meshes until the time budget in microseconds is spent, called once per frame
+	// At least one mesh is uploaded per call, so a budget of zero uploads one mesh per frame
+	// The uploaded meshes are appended to the list, errors of the workers are rethrown here
+	void UploadLoaded(double timeBudget, std::vector<Mesh*> &uploaded);
+
+	// Function to check whether every queued mesh is uploaded
+	bool IsIdle();
+
+	// Function to drop the queued requests and join the workers, meshes still loading are finished first
+	void Stop();
+};
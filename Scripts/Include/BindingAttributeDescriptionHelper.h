@@ -1,11 +1,12 @@
 #pragma once
 
 #include "Vertex.h"
+#include "VertexPacker.h"
 #include "Device.h"
 
 static class BindingAttributeDescriptionHelper
 {
 public:
-	static std::vector<VkVertexInputBindingDescription> getBindingDescription();
-	static std::vector<VkVertexInputAttributeDescription> getAttributeDescriptions();
+	static std::vector<VkVertexInputBindingDescription> getBindingDescription(VertexFormat format = VERTEX_FORMAT_FULL);
+	static std::vector<VkVertexInputAttributeDescription> getAttributeDescriptions(VertexFormat format = VERTEX_FORMAT_FULL);
 };
\ No newline at end of file
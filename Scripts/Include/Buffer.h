@@ -33,6 +33,9 @@ public:
 	// Memory of the buffer
 	VkDeviceMemory memory;
 
+	// Size of the memory allocated for the buffer, which may be larger than the size asked for
+	VkDeviceSize allocationSize;
+
 	// Constructor
 	Buffer(Device *device, VkDeviceSize size, VkBufferUsageFlags usage, VkMemoryPropertyFlags properties);
 	
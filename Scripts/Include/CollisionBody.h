@@ -0,0 +1,146 @@
+#pragma once
+#include <string>
+#include <vector>
+#include "CollisionEngine\Collider.h"
+#include "CollisionShape.h"
+#include "CompoundShape.h"
+
+class CollisionWorld;
+
+// Collision categories, a body is tested against another only if each category is in the mask of the other
+const uint32_t COLLISION_CATEGORY_DEFAULT = 1 << 0;
+const uint32_t COLLISION_CATEGORY_STATIC = 1 << 1;
+const uint32_t COLLISION_CATEGORY_TRIGGER = 1 << 2;
+const uint32_t COLLISION_MASK_ALL = 0xFFFFFFFF;
+
+// Collider together with the summary shape used to reject pairs early
+// The shape is read only and can be shared by bodies in different worlds
+// A body with a shared shape builds no library collider, its pairs are final at the leaves of the shape
+// A body is owned by its world, which deletes it once it is removed or when the world is destroyed
+// The body deletes its collider and its shapes, a shared shape stays with its owner
+class CollisionBody
+{
+private:
+	std::string name;
+
+	// Name the library collider is registered under, unique across worlds
+	std::string colliderName;
+
+	// World the body belongs to
+	CollisionWorld *world;
+
+	// Handle given by the collision world
+	int handle;
+
+	// Category bits of the body and the categories it collides with
+	uint32_t category;
+	uint32_t mask;
+
+	// Position last applied to the library collider
+	Vec3 colliderPosition;
+
+	// Library collider, null for a compound body and a body with a shared shape
+	Collider *collider;
+	CollisionShape *shape;
+
+	// Hierarchy over the parts of a compound body, null for a body made of a single part
+	CompoundShape *compoundShape;
+
+	// Set if the shape is shared with other bodies and cannot be deformed
+	bool isShapeShared;
+
+	// Set once the vertices are updated, the library collider keeps the vertices it was created with
+	bool isDeformed;
+
+	// Function to set the fields shared by all the constructors
+	void Initialize(CollisionWorld *world, std::string name);
+
+	// Function to create the library collider
+	// The library takes its points in a vector of its own, so the viewed vertices are gathered once for it
+	void CreateCollider(PositionView vertices, int octreeDepth);
+
+	// Function to move the vertices found by a point query from the frame of the body to its transform
+	void PlaceNeighbors(CollisionTransform &transform, std::vector<VertexNeighbor> &neighbors);
+
+	// Function to build the summary shape over the cells of the collider octree, or over the vertices without a collider
+	CollisionShape *CreateShape(PositionView vertices, int octreeDepth);
+
+public:
+	// The vertices are only read during construction, so they may be viewed straight from a shared geometry asset
+	CollisionBody(CollisionWorld *world, std::string name, PositionView vertices, int octreeDepth = 4,
+		CollisionShape *sharedShape = nullptr);
+
+	// Constructor of a compound body made of parts placed by rigid local transforms
+	// Pairs are checked through the parts, so the body has no library collider
+	// The summary shape covers all the placed parts for the distance, neighbor and batch queries over the whole body
+	CollisionBody(CollisionWorld *world, std::string name, std::vector<std::vector<Vec3>> &parts,
+		std::vector<CollisionTransform> &localTransforms, int octreeDepth = 4);
+	~CollisionBody();
+
+	std::string GetName();
+	CollisionWorld *GetWorld();
+	int GetHandle();
+	void SetHandle(int handle);
+	uint32_t GetCategory();
+	void SetCategory(uint32_t category);
+	uint32_t GetMask();
+	void SetMask(uint32_t mask);
+	Vec3 GetPosition();
+	CollisionRotation GetRotation();
+	CollisionTransform GetTransform();
+	Collider *GetCollider();
+	CollisionShape *GetShape();
+	CompoundShape *GetCompoundShape();
+	bool IsCompound();
+
+	// Function to check whether the pairs of the body are confirmed against the library octree
+	// Compound, deformed, rotated and shared shape bodies are final at the leaves of their summary shapes instead
+	bool UsesColliderOctree();
+
+	// Functions to queue a move of the body, applied at the start of the next collision loop
+	void Translate(Vec3 translateVec);
+	void SetPosition(Vec3 position);
+
+	// Function to queue a rotation of the body about its origin, replacing the previous one
+	void SetRotation(CollisionRotation rotation);
+
+	// Function to queue new positions for the vertices, given in the order of the constructor
+	void UpdateVertices(std::vector<Vec3> vertices);
+
+	// Function to compare the summary shapes of the body on their lattices, see CollisionShape::SetQuantized
+	// Only pairs of quantized bodies without a rotation between them are checked in fixed point
+	// A shared shape is read only, so it has to be quantized by its owner before it is shared
+	void SetQuantized(bool isQuantized);
+
+	bool IsCollidedWithAny();
+
+	// Function to check the summary shapes of two bodies down to the max depth
+	// Compound bodies are checked through the hierarchy over their parts
+	CollisionResult CheckCollision(CollisionBody *otherBody, int maxDepth);
+
+	// Function to check the other body at many positions without moving either collider
+	// The other body keeps its current rotation at every position
+	void CheckCollisionBatch(CollisionBody *otherBody, std::vector<Vec3> &otherPositions, std::vector<uint64_t> &results);
+
+	// Function to check the other body placed by many rigid transforms without moving either collider
+	void CheckCollisionBatch(CollisionBody *otherBody, std::vector<CollisionTransform> &otherTransforms, std::vector<uint64_t> &results);
+
+	// Functions for proximity queries against the vertices of the body
+	// The queries follow the rotations of the bodies
+	float Distance(CollisionBody *otherBody, float maxDistance = FLT_MAX);
+	bool IsWithinDistance(CollisionBody *otherBody, float distance);
+	Vec3 ClosestPoint(Vec3 point);
+	void KNearest(Vec3 point, int k, std::vector<VertexNeighbor> &results);
+	void KNearestBatch(std::vector<Vec3> &points, int k, std::vector<VertexNeighbor> &results);
+	void RadiusSearch(Vec3 point, float radius, std::vector<VertexNeighbor> &results);
+
+	// Function called by the collision world to refit the shape to the updated vertices
+	void ApplyVertexUpdate(std::vector<Vec3> &vertices);
+
+	// Function called by the collision world to move the collider to the position of the body
+	void SyncCollider(Vec3 position);
+
+	// Functions called by the collision world when a contact begins or ends
+	void BeginContact(std::string otherName);
+	void EndContact(std::string otherName);
+};
@@ -0,0 +1,54 @@
+#pragma once
+#include <atomic>
+#include <string>
+#include <vector>
+#include "Matrix3.h"
+#include "CollisionTransform.h"
+
+class CollisionBody;
+
+// Type of a mutation of the collision world
+enum CollisionCommandType
+{
+	COMMAND_ADD_BODY,
+	COMMAND_REMOVE_BODY,
+	COMMAND_TRANSLATE,
+	COMMAND_SET_POSITION,
+	COMMAND_UPDATE_VERTICES,
+	COMMAND_SET_ROTATION
+};
+
+// Mutation pushed by any thread and applied by the collision loop
+struct CollisionCommand
+{
+	CollisionCommandType type;
+	CollisionBody *body;
+	std::string name;
+	Vec3 vector;
+	std::vector<Vec3> vertices;
+	CollisionRotation rotation;
+	std::atomic<CollisionCommand*> next;
+};
+
+// Lock free queue with many producers and a single consumer
+// Producers only exchange the head, so pushing never blocks or waits for the consumer
+class CollisionCommandQueue
+{
+private:
+	std::atomic<CollisionCommand*> head;
+	CollisionCommand *tail;
+
+	// Placeholder node so that the queue is never empty
+	CollisionCommand stub;
+
+public:
+	CollisionCommandQueue();
+	~CollisionCommandQueue();
+
+	// Function to push a command, safe to call from any thread
+	void Push(CollisionCommand *command);
+
+	// Function to pop the oldest command, only called by the consumer
+	// Returns null if the queue is empty or a push is still in progress
+	CollisionCommand *Pop();
+};
@@ -0,0 +1,309 @@
+#pragma once
+#include <vector>
+#include <cstdint>
+#include <cfloat>
+#include <algorithm>
+#include <unordered_map>
+#include "Matrix3.h"
+#include "CollisionTransform.h"
+#include "PositionView.h"
+
+// Axis aligned box used for the summary bounds of a collision shape
+struct BoundingBox
+{
+	Vec3 minPosition;
+	Vec3 maxPosition;
+
+	// Function to check whether two boxes overlap when the second one is shifted by offset
+	static bool Overlaps(BoundingBox box, BoundingBox otherBox, Vec3 offset)
+	{
+		return box.minPosition.x <= otherBox.maxPosition.x + offset.x && otherBox.minPosition.x + offset.x <= box.maxPosition.x &&
+			box.minPosition.y <= otherBox.maxPosition.y + offset.y && otherBox.minPosition.y + offset.y <= box.maxPosition.y &&
+			box.minPosition.z <= otherBox.maxPosition.z + offset.z && otherBox.minPosition.z + offset.z <= box.maxPosition.z;
+	}
+
+	// Function to check whether two boxes overlap when the second one is placed by the relative transform
+	// Rotated boxes are tested on the 15 separating axes of two oriented boxes
+	static bool Overlaps(BoundingBox box, BoundingBox otherBox, RelativeTransform &relative);
+
+	// Function to get the box enclosing two boxes
+	static BoundingBox Merge(BoundingBox box, BoundingBox otherBox)
+	{
+		BoundingBox merged;
+		merged.minPosition = Vec3(std::min(box.minPosition.x, otherBox.minPosition.x),
+			std::min(box.minPosition.y, otherBox.minPosition.y),
+			std::min(box.minPosition.z, otherBox.minPosition.z));
+		merged.maxPosition = Vec3(std::max(box.maxPosition.x, otherBox.maxPosition.x),
+			std::max(box.maxPosition.y, otherBox.maxPosition.y),
+			std::max(box.maxPosition.z, otherBox.maxPosition.z));
+		return merged;
+	}
+
+	// Function to get a box that overlaps nothing and leaves any box unchanged when merged
+	static BoundingBox Empty()
+	{
+		BoundingBox empty;
+		empty.minPosition = Vec3(FLT_MAX, FLT_MAX, FLT_MAX);
+		empty.maxPosition = Vec3(-FLT_MAX, -FLT_MAX, -FLT_MAX);
+		return empty;
+	}
+};
+
+// Sphere enclosing all the occupied cells of a collision shape
+struct BoundingSphere
+{
+	Vec3 center;
+	float radius;
+};
+
+// Result of a collision query that may stop before the leaves
+enum CollisionResult
+{
+	COLLISION_NONE,
+	COLLISION_POSSIBLE,
+	COLLISION_CONFIRMED
+};
+
+// Relative transforms of many poses stored per component so that the poses are tested in blocks of 64 lanes
+// The rotations are only laid out if some pose is rotated against the shape, the other poses are tested as offsets
+struct PoseBatch
+{
+	std::vector<float> translation[3];
+	std::vector<float> rotation[9];
+	std::vector<float> absoluteRotation[9];
+
+	// Bit set for every pose rotated against the shape
+	std::vector<uint64_t> rotatedMask;
+	size_t wordCount;
+};
+
+// Vertex found by a neighbor query
+struct VertexNeighbor
+{
+	Vec3 vertex;
+	float distanceSquared;
+
+	bool operator<(const VertexNeighbor &other) const
+	{
+		return distanceSquared < other.distanceSquared;
+	}
+};
+
+// Bits of the lattice a quantized shape is stored on, the octree depth of a quantized shape cannot exceed it
+const int QUANTIZED_BITS = 15;
+
+// Bounds of a node on the lattice of its shape, 12 bytes per node
+// Empty bounds have their minimum above their maximum
+struct QuantizedBox
+{
+	uint16_t minPosition[3];
+	uint16_t maxPosition[3];
+};
+
+// Fixed point map from the lattice of another shape to the lattice of a shape, with 16 fractional bits
+// Minimums are rounded down and maximums up, so the mapped boxes never shrink
+struct QuantizedTransform
+{
+	int64_t lowScale[3];
+	int64_t highScale[3];
+	int64_t lowBias[3];
+	int64_t highBias[3];
+};
+
+// Node of the summary octree, its bounds are kept by the shape apart from the node
+struct ShapeNode
+{
+	int firstChild;
+	int childCount;
+	int depth;
+	int parent;
+
+	// Prefix of the morton codes of the cells below the node
+	uint64_t code;
+
+	// Number of vertices lying in the cells below the node
+	// Leaves link their vertices from the first one, -1 for a leaf without vertices
+	int firstVertex;
+	int vertexCount;
+};
+
+// Pair of nodes waiting in a distance query, ordered by the lower bound of their distance
+struct NodePair
+{
+	float lowerBound;
+	int node;
+	int otherNode;
+
+	bool operator>(const NodePair &other) const
+	{
+		return lowerBound > other.lowerBound;
+	}
+};
+
+// Summary of the octree of a collider
+// Mirrors the leaf cells of the collision library octree so that it can reject pairs
+// before the library descends its own tree
+// The shape is read only unless its vertices are updated, which refits the occupied cells in place
+class CollisionShape
+{
+private:
+	int octreeDepth;
+	Vec3 rootMin;
+	Vec3 cellSize;
+	BoundingSphere boundingSphere;
+	std::vector<ShapeNode> nodes;
+
+	// Vertices sorted by the leaf cell they fall into, linked per leaf in both directions
+	std::vector<Vec3> vertices;
+	std::vector<int> nextVertices;
+	std::vector<int> previousVertices;
+
+	// Slot in the sorted vertices of every vertex given to the constructor
+	std::vector<int> vertexSlots;
+
+	// Number of vertices marking every occupied cell and the leaf of every cell that has been occupied
+	// Only filled once the vertices are first updated
+	std::unordered_map<uint64_t, int> cellMarks;
+	std::unordered_map<uint64_t, int> leavesByCell;
+
+	// Number of nodes left unreachable after moving the children of a node
+	int unusedNodeCount;
+
+	// Bounds of the nodes, as floats or only on the lattice while the shape is quantized
+	// Bounds enclose only the occupied leaf cells below a node, not the whole cell of the node
+	bool isQuantized;
+	std::vector<BoundingBox> nodeBounds;
+	std::vector<QuantizedBox> quantizedBounds;
+
+	// Size of a lattice step on every axis, only set while the shape is quantized
+	Vec3 latticeStep;
+
+	// Functions to build the summary octree from the occupied leaf cells
+	void Build(PositionView vertices);
+	int MarkCells(Vec3 vertex, uint64_t cells[8]);
+	void MarkCells(Vec3 vertex, std::vector<uint64_t> &cells);
+	uint64_t GetVertexCell(Vec3 vertex);
+	void SortVertices(PositionView vertices, std::vector<uint64_t> &vertexCells);
+	void BuildNode(int nodeIndex, std::vector<uint64_t> &cells, int begin, int end, int depth,
+		std::vector<uint64_t> &vertexCells);
+	void ComputeBoundingSphere();
+	BoundingBox GetCellBounds(uint64_t cell);
+
+	// Functions to update the occupied cells after vertices move
+	void InitializeOccupancy();
+	void AddCell(uint64_t cell);
+	void RemoveCell(uint64_t cell);
+	int InsertLeaf(uint64_t cell);
+	int AddChild(int node, uint64_t code);
+	void RefitAncestors(int node);
+	void MoveVertex(int slot, int leaf, int otherLeaf);
+
+	// Functions to read and write the node bounds in the representation the shape is in
+	// Bounds read from a quantized shape are taken off the lattice
+	void ResizeNodeBounds();
+	BoundingBox GetNodeBounds(int node);
+	bool IsNodeEmpty(int node);
+	void SetLeafBounds(int node, uint64_t cell);
+	void ClearNodeBounds(int node);
+
+	// Function to set the bounds of a node to the union of its children, returns whether they changed
+	bool MergeChildBounds(int node);
+
+	// Function to set the bounds below a node again from the occupied leaves, after the representation changed
+	void FitNodeBounds(int node, std::vector<uint8_t> &occupiedLeaves);
+
+	// Functions to put the node bounds on the lattice
+	QuantizedBox QuantizeCell(uint64_t cell);
+	void GetLatticeStep(int axis, int64_t &mantissa, int &exponent);
+	QuantizedTransform GetQuantizedTransform(CollisionShape *otherShape, Vec3 offset);
+
+	// Function to check two nodes recursively up to the max depth
+	// Nodes are compared on the lattice if the quantized transform is given
+	CollisionResult CheckNodes(int node, CollisionShape *otherShape, int otherNode, RelativeTransform &relative,
+		QuantizedTransform *quantized, int maxDepth);
+
+	// Function to check two nodes for all the live poses, one bit per pose
+	// Offset poses are tested on the axes of this shape and rotated poses on the separating axes, four lanes at a time
+	void CheckNodesBatch(int node, CollisionShape *otherShape, int otherNode, PoseBatch &poses,
+		std::vector<std::vector<uint64_t>> &masks, int level, std::vector<uint64_t> &results);
+
+	// Function to reject the poses on the bounding spheres and then check the live poses in a single traversal
+	void CheckPosesBatch(CollisionShape *otherShape, PoseBatch &poses, size_t poseCount, std::vector<uint64_t> &results);
+
+	// Function to find the closest vertices of two leaves, returns the squared distance
+	float GetLeafDistanceSquared(int node, CollisionShape *otherShape, int otherNode, RelativeTransform &relative);
+
+	// Function to search the node pairs best first, stopping once no pair can be closer than the best one
+	// If stop distance is positive, the search also stops at the first pair found closer than it
+	// Rotated nodes are bounded by the boxes enclosing them in the frame of this shape, which keeps the bounds below the distance
+	float FindDistanceSquared(CollisionShape *otherShape, RelativeTransform &relative, float maxDistance, float stopDistance);
+
+	// Function to keep the k closest vertices to the local point in a max heap stored in the results
+	void FindNearest(Vec3 localPoint, int k, VertexNeighbor *results, int &count);
+public:
+	// The vertices are read through the view and binned into the cell ordered array of the shape
+	CollisionShape(PositionView vertices, Vec3 rootMin, Vec3 rootMax, int octreeDepth);
+
+	// Function to move the vertices to new positions, given in the order of the constructor
+	// Only the vertices that changed cells are binned again and only the nodes above them are refit
+	// Vertices stay in the cells of the root bounds, so the root should enclose the whole deformation
+	void UpdateVertices(std::vector<Vec3> &newVertices);
+
+	// Function to store the node bounds on a 16 bit lattice relative to the root bounds, in place of the float bounds
+	// Pairs of quantized shapes that are not rotated against each other are compared in fixed point,
+	// which gives the same results on every build, and only differ from the float results within a lattice step
+	// Other queries read the bounds back off the lattice
+	void SetQuantized(bool isQuantized);
+	bool IsQuantized();
+
+	BoundingSphere GetBoundingSphere();
+	BoundingBox GetBounds();
+	int GetOctreeDepth();
+
+	// Function to check the shapes down to the max depth
+	// Overlapping leaf cells confirm the collision, overlapping nodes cut off by the max depth only make it possible
+	CollisionResult CheckCollision(CollisionShape *otherShape, Vec3 position, Vec3 otherPosition, int maxDepth);
+
+	// Function to check the shapes placed by rigid transforms, the octrees are rotated instead of rebuilt
+	CollisionResult CheckCollision(CollisionShape *otherShape, CollisionTransform transform, CollisionTransform otherTransform,
+		int maxDepth);
+
+	// Function to check the other shape at many positions in a single traversal
+	// Bit i of the results is set if the other shape at position i collides, the leaf cells decide the result
+	void CheckCollisionBatch(CollisionShape *otherShape, Vec3 position, std::vector<Vec3> &otherPositions,
+		std::vector<uint64_t> &results);
+
+	// Function to check the other shape placed by many rigid transforms in a single traversal
+	// Every pose may carry a rotation of its own, poses rotated against this shape are tested on the separating axes
+	void CheckCollisionBatch(CollisionShape *otherShape, CollisionTransform transform, std::vector<CollisionTransform> &otherTransforms,
+		std::vector<uint64_t> &results);
+
+	// Function to find the distance between the closest vertices of the shapes
+	// Returns the max distance if the shapes are at least that far apart
+	float Distance(CollisionShape *otherShape, Vec3 position, Vec3 otherPosition, float maxDistance = FLT_MAX);
+	float Distance(CollisionShape *otherShape, CollisionTransform transform, CollisionTransform otherTransform,
+		float maxDistance = FLT_MAX);
+
+	// Function to check whether the shapes come closer than the distance, stops at the first close pair
+	bool IsWithinDistance(CollisionShape *otherShape, Vec3 position, Vec3 otherPosition, float distance);
+	bool IsWithinDistance(CollisionShape *otherShape, CollisionTransform transform, CollisionTransform otherTransform,
+		float distance);
+
+	// Function to find the vertex of the shape closest to the point
+	Vec3 ClosestPoint(Vec3 point, Vec3 position);
+
+	// Function to find the k vertices closest to the point, sorted by distance
+	// The results are reused between calls, so queries only allocate when k grows
+	void KNearest(Vec3 point, Vec3 position, int k, std::vector<VertexNeighbor> &results);
+
+	// Function to find the k nearest vertices of every point
+	// The neighbors of point i are stored at i * k in the results, unused entries have an infinite distance
+	void KNearestBatch(std::vector<Vec3> &points, Vec3 position, int k, std::vector<VertexNeighbor> &results);
+
+	// Function to find all the vertices within the radius of the point, in no particular order
+	void RadiusSearch(Vec3 point, Vec3 position, float radius, std::vector<VertexNeighbor> &results);
+
+	// Function to check whether the shapes may collide using only the bounding sphere and
+	// the summary bounds of the nodes up to the max depth
+	bool MayCollide(CollisionShape *otherShape, Vec3 position, Vec3 otherPosition, int maxDepth);
+};
@@ -0,0 +1,104 @@
+#pragma once
+#include "Matrix3.h"
+
+// Rotation of a collision body stored by rows
+struct CollisionRotation
+{
+	float values[3][3];
+
+	static CollisionRotation Identity()
+	{
+		CollisionRotation identity;
+		for (int i = 0; i < 3; i++)
+			for (int j = 0; j < 3; j++)
+				identity.values[i][j] = i == j ? 1.0f : 0.0f;
+		return identity;
+	}
+
+	bool IsIdentity()
+	{
+		return IsEqual(Identity());
+	}
+
+	bool IsEqual(CollisionRotation other)
+	{
+		for (int i = 0; i < 3; i++)
+			for (int j = 0; j < 3; j++)
+				if (values[i][j] != other.values[i][j])
+					return false;
+		return true;
+	}
+
+	Vec3 Rotate(Vec3 vector)
+	{
+		return Vec3(values[0][0] * vector.x + values[0][1] * vector.y + values[0][2] * vector.z,
+			values[1][0] * vector.x + values[1][1] * vector.y + values[1][2] * vector.z,
+			values[2][0] * vector.x + values[2][1] * vector.y + values[2][2] * vector.z);
+	}
+
+	// Function to get the rotation applying the other rotation first and then this one
+	CollisionRotation Multiply(CollisionRotation other)
+	{
+		CollisionRotation product;
+		for (int i = 0; i < 3; i++)
+			for (int j = 0; j < 3; j++)
+				product.values[i][j] = values[i][0] * other.values[0][j] + values[i][1] * other.values[1][j] +
+					values[i][2] * other.values[2][j];
+		return product;
+	}
+
+	// Function to rotate by the inverse, which is the transpose for a rotation
+	Vec3 RotateInverse(Vec3 vector)
+	{
+		return Vec3(values[0][0] * vector.x + values[1][0] * vector.y + values[2][0] * vector.z,
+			values[0][1] * vector.x + values[1][1] * vector.y + values[2][1] * vector.z,
+			values[0][2] * vector.x + values[1][2] * vector.y + values[2][2] * vector.z);
+	}
+};
+
+// Rigid transform of a collision body, vertices are rotated about the origin of the body and then moved to the position
+struct CollisionTransform
+{
+	Vec3 position;
+	CollisionRotation rotation;
+};
+
+// Transform of a shape expressed in the frame of another shape
+struct RelativeTransform
+{
+	// Set if the rotations differ, otherwise the shapes are only offset by the translation
+	bool isRotated;
+	float rotation[3][3];
+
+	// Absolute values of the rotation, widened slightly so that parallel edges do not hide an overlap
+	float absoluteRotation[3][3];
+	Vec3 translation;
+
+	static RelativeTransform Create(CollisionTransform transform, CollisionTransform otherTransform)
+	{
+		RelativeTransform relative;
+		relative.translation = transform.rotation.RotateInverse(otherTransform.position - transform.position);
+		relative.isRotated = !transform.rotation.IsEqual(otherTransform.rotation);
+		for (int i = 0; i < 3; i++)
+		{
+			for (int j = 0; j < 3; j++)
+			{
+				relative.rotation[i][j] = transform.rotation.values[0][i] * otherTransform.rotation.values[0][j] +
+					transform.rotation.values[1][i] * otherTransform.rotation.values[1][j] +
+					transform.rotation.values[2][i] * otherTransform.rotation.values[2][j];
+				relative.absoluteRotation[i][j] = fabsf(relative.rotation[i][j]) + 1e-6f;
+			}
+		}
+		return relative;
+	}
+
+	// Function to move a point of the other shape into the frame of this one
+	Vec3 Apply(Vec3 point)
+	{
+		if (!isRotated)
+			return point + translation;
+		return Vec3(rotation[0][0] * point.x + rotation[0][1] * point.y + rotation[0][2] * point.z + translation.x,
+			rotation[1][0] * point.x + rotation[1][1] * point.y + rotation[1][2] * point.z + translation.y,
+			rotation[2][0] * point.x + rotation[2][1] * point.y + rotation[2][2] * point.z + translation.z);
+	}
+};
@@ -0,0 +1,192 @@
+#pragma once
+#include <string>
+#include <vector>
+#include <set>
+#include <functional>
+#include <atomic>
+#include <chrono>
+#include <unordered_map>
+#include "CollisionBody.h"
+#include "CollisionCommandQueue.h"
+#include "CollisionWorldState.h"
+
+// Depth of the summary octree a pair is first checked at, depth 1 is the octants of the root
+// Pairs that are still possible are refined one depth at a time until they are resolved or the time budget runs out
+const int EARLY_OUT_DEPTH = 2;
+
+// Weights of the pair priority when the collision loop has a time budget
+// Pairs colliding in the last loop come first, then fast moving pairs, pairs near the view and pairs waiting longest
+const float RECENT_COLLISION_PRIORITY = 1000.0f;
+const float SPEED_PRIORITY = 10.0f;
+const float VIEW_PRIORITY = 100.0f;
+const float WAITING_PRIORITY = 1.0f;
+
+// Pairs left unchecked for this many loops go before every other pair, longest waiting first
+// At least one pair is checked every loop, so no pair waits longer than this plus the number of pairs
+const int MAX_WAITING_LOOPS = 16;
+
+// Pair of bodies scheduled for a collision loop
+struct ScheduledPair
+{
+	CollisionBody *body;
+	CollisionBody *otherBody;
+	uint64_t pairKey;
+	float priority;
+	int waitingLoops;
+};
+
+// Type of a collision event
+enum CollisionEventType
+{
+	COLLISION_BEGIN,
+	COLLISION_END
+};
+
+// Change in the contact state of a pair of bodies since the last collision loop
+struct CollisionEvent
+{
+	CollisionEventType type;
+	int handle;
+	int otherHandle;
+};
+
+// Callback deciding whether two bodies, given by their handles, should be tested
+typedef std::function<bool(int handle, int otherHandle)> CollisionFilter;
+
+// Independent set of collision bodies with its own collision loop
+// Worlds share no mutable state, so each world can be stepped on its own thread
+// The library colliders of a world are registered under a prefix of the world, so same named bodies of other worlds never clash
+// Pairs are filtered on the categories, masks, ignored pairs and the filter callback first,
+// then rejected on the bounding spheres and summary bounds, and only the remaining pairs
+// are checked against the library octree, except pairs with a compound, deformed, rotated or shared shape body
+// which are final at the leaves
+// Bodies carry a rigid transform, rotated octrees are tested with oriented boxes instead of being rebuilt
+// The colliding pairs are diffed against the previous loop to produce begin and end events
+// Adding, removing and moving bodies is queued from any thread and applied at the start of the loop
+// Positions, contacts, colliding pairs and the refinement and scheduling data of the pairs live in a
+// CollisionWorldState that can be saved and restored
+// With a time budget, pairs are checked in order of priority, pairs left unresolved are reported as colliding
+// and refined further in later loops, and pairs left unchecked keep their last result and are flagged stale
+class CollisionWorld
+{
+private:
+	bool isActive;
+
+	// Prefix of the names the library colliders of the world are registered under
+	// The library keeps a single registry for the process, so every world registers under a prefix of its own
+	std::string colliderPrefix;
+
+	std::vector<CollisionBody*> bodies;
+	std::atomic<int> nextHandle;
+
+	// Mutations waiting for the next collision loop
+	CollisionCommandQueue commands;
+
+	// Bodies indexed by their handle, removed bodies are null
+	std::vector<CollisionBody*> bodiesByHandle;
+
+	// Positions, contacts, the colliding pairs of the previous loop and the data of the pairs
+	CollisionWorldState state;
+
+	// Keys of the pairs colliding in the current loop, and the depths and waiting loops of its pairs
+	// They are collected unsorted during the loop and moved into the state at its end
+	std::vector<uint64_t> collidingPairs;
+	std::vector<PairValue> pairDepths;
+	std::vector<PairValue> pairWaitingLoops;
+
+	// Set when a restored state has to be copied to the collided objects of the colliders
+	bool isStateRestored;
+
+	// Time budget of a collision loop in microseconds, zero for no budget
+	double timeBudget;
+	std::chrono::steady_clock::time_point deadline;
+
+	// Pairs of the current loop in the order they are checked
+	std::vector<ScheduledPair> scheduledPairs;
+
+	// Position the pairs near to are checked first
+	Vec3 viewPosition;
+
+	// Events produced by the last collision loop and the events produced since then
+	std::vector<CollisionEvent> events;
+	std::vector<CollisionEvent> pendingEvents;
+
+	// Pairs of handles that are never tested
+	std::set<uint64_t> ignoredPairs;
+
+	// Optional callback to filter the pairs
+	CollisionFilter pairFilter;
+
+	// Function to get the key of a pair independent of the order of the handles
+	static uint64_t GetPairKey(int handle, int otherHandle);
+
+	// Functions to apply the queued mutations
+	void PushCommand(CollisionCommandType type, CollisionBody *body, std::string name, Vec3 vector);
+	void ApplyCommands();
+	void ApplyAddBody(CollisionBody *body);
+	void ApplyRemoveBody(std::string name);
+
+	// Function to check whether a pair should be tested without touching its geometry
+	bool ShouldCollide(CollisionBody *body, CollisionBody *otherBody);
+
+	// Function to check a single pair of bodies, refining it as far as the time budget allows
+	CollisionResult CheckCollision(CollisionBody *body, CollisionBody *otherBody);
+	bool IsOverBudget();
+
+	// Functions to order the pairs by priority
+	void SchedulePairs();
+	float GetPairPriority(CollisionBody *body, CollisionBody *otherBody, uint64_t pairKey, int waitingLoops);
+	bool WasColliding(uint64_t pairKey);
+
+	// Function to diff the colliding pairs against the previous loop and emit the events
+	void UpdateEvents();
+	void AddEvent(CollisionEventType type, uint64_t pairKey);
+
+	// Function to rebuild the collided objects of the colliders from the restored pairs
+	void RefreshCollidedObjects();
+public:
+	CollisionWorld();
+	void SetActive(bool isActive);
+	void SetViewPosition(Vec3 viewPosition);
+
+	// Function to get the name a body of the world registers its library collider under
+	std::string GetColliderName(std::string name);
+
+	// Function to check the pairs of bodies, within the time budget in microseconds if it is not zero
+	void CollisionLoop(double timeBudget = 0.0);
+
+	// Functions to queue mutations, safe to call from any thread
+	// The world takes ownership of an added body and deletes it when it is removed, so it must not be used after RemoveBody
+	void AddBody(CollisionBody *body);
+	void RemoveBody(std::string name);
+	void TranslateBody(CollisionBody *body, Vec3 translateVec);
+	void SetBodyPosition(CollisionBody *body, Vec3 position);
+	void SetBodyRotation(CollisionBody *body, CollisionRotation rotation);
+	void UpdateBodyVertices(CollisionBody *body, std::vector<Vec3> &vertices);
+
+	void IgnorePair(int handle, int otherHandle, bool ignore = true);
+	void SetPairFilter(CollisionFilter filter);
+
+	// Events of the last collision loop, valid until the next loop
+	std::vector<CollisionEvent> &GetEvents();
+
+	// Pairs of the last collision loop that are only possibly colliding
+	std::vector<uint64_t> GetPossiblePairs();
+
+	// Pairs left unchecked in the last collision loop, colliding or not, which kept the result of an earlier loop
+	std::vector<uint64_t> GetStalePairs();
+
+	// Functions to read the state of a body
+	Vec3 GetBodyPosition(int handle);
+	CollisionRotation GetBodyRotation(int handle);
+	int GetContactCount(int handle);
+
+	// Function to copy the current state into a snapshot
+	void SaveState(CollisionWorldState &snapshot);
+
+	// Function to restore a snapshot by swapping it with the current state in constant time
+	// The snapshot holds the replaced state afterwards
+	// Bodies added or removed since the snapshot was saved are not restored
+	void SwapState(CollisionWorldState &snapshot);
+	~CollisionWorld();
+};
@@ -0,0 +1,87 @@
+#pragma once
+#include <vector>
+#include <cstdint>
+#include "Matrix3.h"
+#include "CollisionTransform.h"
+
+// Value kept for a pair of bodies, arrays of them are sorted by the key of the pair
+struct PairValue
+{
+	uint64_t pairKey;
+	int value;
+};
+
+// Arrays of a collision world state, in the order they are laid out in its block
+enum CollisionStateArray
+{
+	// Positions, rotations and contact counts of the bodies, and their positions in the loop before
+	STATE_POSITIONS,
+	STATE_ROTATIONS,
+	STATE_CONTACT_COUNTS,
+	STATE_PREVIOUS_POSITIONS,
+
+	// Sorted keys of the pairs colliding in the last loop, of the pairs reported as colliding without reaching the leaves
+	// and of the pairs left unchecked
+	STATE_COLLIDING_PAIRS,
+	STATE_POSSIBLE_PAIRS,
+	STATE_STALE_PAIRS,
+
+	// Depth each pair has been refined to and the number of loops each pair has been left unchecked, as PairValue
+	STATE_PAIR_DEPTHS,
+	STATE_PAIR_WAITING_LOOPS,
+
+	STATE_ARRAY_COUNT
+};
+
+// Start of the block of a collision world state, the arrays follow at the given offsets
+struct CollisionStateHeader
+{
+	uint64_t offsets[STATE_ARRAY_COUNT];
+	uint32_t counts[STATE_ARRAY_COUNT];
+	uint32_t capacities[STATE_ARRAY_COUNT];
+};
+
+// Mutable state of a collision world kept in a single block of memory
+// Per body arrays are indexed by body handle, the others hold the data of the pairs
+// Saving copies the block and restoring swaps it, so the colliders are never rebuilt
+// Pointers to the arrays are only valid until an array grows
+class CollisionWorldState
+{
+private:
+	std::vector<char> block;
+
+	CollisionStateHeader *GetHeader();
+
+	// Function to lay the arrays out again with room for at least the given count in the array
+	void Grow(CollisionStateArray array, size_t count);
+
+public:
+	CollisionWorldState();
+
+	template <typename T>
+	T *GetArray(CollisionStateArray array)
+	{
+		return (T*)(block.data() + GetHeader()->offsets[array]);
+	}
+	size_t GetCount(CollisionStateArray array);
+
+	// Functions to change the contents of an array, new elements are left uninitialized
+	void Resize(CollisionStateArray array, size_t count);
+	void Assign(CollisionStateArray array, const void *values, size_t count);
+	void Push(CollisionStateArray array, const void *value);
+
+	// Function to copy an array over another array of the same element type
+	void CopyArray(CollisionStateArray array, CollisionStateArray sourceArray);
+
+	// Function to find the value of a pair in a sorted array of PairValue, null if the pair has none
+	int *FindPairValue(CollisionStateArray array, uint64_t pairKey);
+
+	// Function to drop the pairs of a body from the possible, stale, depth and waiting arrays
+	void RemovePairsOfBody(int handle);
+
+	// Function to resize the per body arrays to hold the handle
+	void Reserve(int handle);
+
+	// Function to swap the blocks of two states in constant time
+	void Swap(CollisionWorldState &other);
+};
@@ -0,0 +1,57 @@
+#pragma once
+#include <vector>
+#include "CollisionShape.h"
+
+// Part of a compound shape with its own summary octree, placed by a rigid transform in the frame of the compound
+// The bounds enclose the rotated part in the frame of the compound
+struct CompoundChild
+{
+	CollisionShape *shape;
+	CollisionTransform localTransform;
+	BoundingBox bounds;
+};
+
+// Node of the hierarchy over the children, leaves hold a single child
+struct CompoundNode
+{
+	BoundingBox bounds;
+	int left;
+	int right;
+	int child;
+};
+
+// Shape built from several parts, each with a summary octree fitted to the part
+// A hierarchy of boxes over the parts is descended before the octrees of the parts,
+// so the bounds stay tight for assets whose parts are far apart
+class CompoundShape
+{
+private:
+	std::vector<CompoundChild> children;
+	std::vector<CompoundNode> nodes;
+
+	// Function to build the hierarchy over the children by splitting them at the median of the longest axis
+	int BuildNode(std::vector<int> &childIndices, int begin, int end);
+
+	// Functions to check the hierarchy against a single shape or another hierarchy
+	// The relative transform places the other shape in the frame of this one
+	CollisionResult CheckNode(int node, CollisionShape *otherShape, BoundingBox otherBounds,
+		CollisionTransform &transform, CollisionTransform &otherTransform, RelativeTransform &relative, int maxDepth);
+	CollisionResult CheckNodes(int node, CompoundShape *otherShape, int otherNode,
+		CollisionTransform &transform, CollisionTransform &otherTransform, RelativeTransform &relative, int maxDepth);
+public:
+	CompoundShape(std::vector<std::vector<Vec3>> &parts, std::vector<CollisionTransform> &localTransforms, int octreeDepth);
+	~CompoundShape();
+
+	int GetChildCount();
+
+	// Function to put the shapes of all the children on their lattices
+	void SetQuantized(bool isQuantized);
+	CompoundChild GetChild(int index);
+
+	// Functions to check the parts down to the max depth of their octrees
+	// The local transforms of the parts are applied before the transform of the compound shape
+	CollisionResult CheckCollision(CollisionShape *otherShape, CollisionTransform transform, CollisionTransform otherTransform,
+		int maxDepth);
+	CollisionResult CheckCollision(CompoundShape *otherShape, CollisionTransform transform, CollisionTransform otherTransform,
+		int maxDepth);
+};
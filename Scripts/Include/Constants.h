@@ -7,6 +7,14 @@
 #define COLOR_MATCH_FUNCTIONS "Resources/ColorMatchingFunctions.xml"
 #define CHROMATICITY_COORDS "Resources/ChromaticityCoords.xml"
 #define MODEL "Assets/Models/sphere.obj"
+// Layout of the mesh vertex buffers, one of the VertexFormat values
+// The packed layouts are drawn with PACKED_VERTEX_SHADER, which has to be compiled with Shaders/compile.bat
+#define MESH_VERTEX_FORMAT VERTEX_FORMAT_FULL
+#define PACKED_VERTEX_SHADER "shaders/packed_vert.spv"
+// Whether the CPU copies of the geometry are released once the meshes are uploaded and their collision bodies built
+// A mesh loaded later from the same file reads the geometry again
+// The instance buffer is also sized for the single instance drawn instead of for 10^6 instances
+#define MEMORY_BUDGET_MODE false
 #define OPACITY_MAP "Assets/Textures/octree_opacity_map.ppm"
 #define NORMAL_MAP "Assets/Textures/normal_map.ppm"
 #define WINDOW_TITLE "Rendering Biological Iridescence"
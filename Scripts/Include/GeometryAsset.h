@@ -0,0 +1,218 @@
+#pragma once
+#include <string>
+#include <vector>
+#include <mutex>
+#include <cstdint>
+#include <unordered_map>
+#include "vertex.h"
+#include "MappedFile.h"
+#include "PositionView.h"
+
+// Version of the binary mesh cache, bump it whenever the layout of the file or of Vertex changes
+const uint32_t MESH_CACHE_VERSION = 5;
+
+// Whether imported meshes are reordered for the vertex cache, overdraw and vertex fetch
+const bool OPTIMIZE_IMPORTED_MESHES = true;
+
+// Whether the statistics of imported and uploaded meshes are printed, for debugging
+const bool PRINT_MESH_STATISTICS = false;
+
+// Largest number of levels of detail of an imported mesh, including the full mesh, one disables the simplification
+// Every level aims for half the triangles of the level before it
+const int MESH_LOD_COUNT = 4;
+
+// Largest simplification error of a level of detail, relative to the diagonal of the bounds
+const float MESH_LOD_MAX_ERROR = 0.05f;
+
+// Range of the index buffer drawing a level of detail, and its error in model units
+struct MeshLod
+{
+	uint32_t indexOffset;
+	uint32_t indexCount;
+	float error;
+};
+
+// Alignment of the blobs of the binary mesh cache
+const uint64_t MESH_CACHE_ALIGNMENT = 16;
+
+// Header at the start of a .meshbin file
+// The blobs follow at the given offsets, vertices laid out exactly as Vertex, indices as uint32
+// and positions as all the x coordinates followed by all the y and then all the z coordinates
+// The indices of every level of detail follow one another
+// The size and write time of the source file are stored so that a stale cache is imported again
+struct MeshCacheHeader
+{
+	char magic[8];
+	uint32_t version;
+	uint32_t vertexSize;
+	uint64_t sourceSize;
+	int64_t sourceTime;
+
+	uint64_t vertexCount;
+	uint64_t indexCount;
+	uint64_t positionCount;
+	uint64_t materialLength;
+
+	uint64_t vertexOffset;
+	uint64_t indexOffset;
+	uint64_t positionOffset;
+	uint64_t lodOffset;
+	uint64_t materialOffset;
+
+	float minPosition[3];
+	float maxPosition[3];
+
+	// Whether the geometry was optimized, and the average cache miss ratio of the obj face order and of the stored order
+	uint32_t isOptimized;
+	float importACMR;
+	float optimizedACMR;
+
+	// Number of levels of detail asked for and stored, the levels are laid out as MeshLod
+	uint32_t maxLodCount;
+	uint32_t lodCount;
+
+	// Settings the geometry was built with, a cache built with other settings is imported again
+	float lodMaxError;
+	uint32_t vertexCacheSize;
+	float overdrawThreshold;
+};
+
+// Geometry of a model file, imported once and shared read only by every mesh and collision body made from it
+// The file is read in a single pass, the arrays are moved out of the reader and handed out in place, the positions through a view
+// The imported geometry is optionally reordered by the MeshOptimizer and written to a .meshbin file next to the model,
+// later loads map that file instead and hand out the vertices, indices and positions straight from the mapping
+// Once every holder has uploaded the geometry the vertices, indices and positions may be released,
+// the levels of detail, bounds and material stay, and a later Load reads the geometry again
+class GeometryAsset
+{
+private:
+	std::string filename;
+
+	// Distinct vertices of the faces, laid out for the vertex buffer, and the triangles of every level of detail over them
+	// They point into the cache mapping if the asset was loaded from the cache, else into the arrays below
+	Vertex *vertices;
+	size_t vertexCount;
+	uint32_t *indices;
+	size_t indexCount;
+
+	// Arrays holding the geometry of an asset imported from the model file
+	std::vector<Vertex> importedVertices;
+	std::vector<uint32_t> importedIndices;
+	std::vector<float> importedPositions;
+
+	// Mapping of the cache file, null if the asset was imported from the model file
+	MappedFile *cacheFile;
+
+	// Whether the arrays above and the positions are held, they are released once every holder has uploaded them
+	bool isDataLoaded;
+
+	// Whether the geometry was read once, the levels of detail of later reads have to match it
+	bool hasLoaded;
+
+	// Lock of the geometry and of the pending upload count, held while the geometry is read
+	// Holders loading the same file wait on it for the first one, while other files are read meanwhile
+	std::mutex dataMutex;
+
+	// Distinct positions of the file, the point set of the collision bodies
+	// Stored per axis, the x coordinates of all the positions followed by the y and then the z coordinates
+	// They point into the cache mapping or into the imported positions, like the vertices
+	const float *positions;
+	size_t positionCount;
+	Vec3 minPosition;
+	Vec3 maxPosition;
+
+	// Material library named by the file, empty if there is none
+	std::string materialFilename;
+
+	// Average cache miss ratio of the triangles in obj face order and in the stored order
+	float importACMR;
+	float optimizedACMR;
+
+	// Levels of detail from the full mesh to the coarsest
+	std::vector<MeshLod> lods;
+
+	// Number of meshes holding the asset, and the number of those that have not uploaded it yet
+	// The first is guarded by the lock of the registry and the second by the lock of the data
+	int referenceCount;
+	int pendingUploadCount;
+
+	// Size and write time of the model file when the asset was first loaded
+	uint64_t sourceSize;
+	int64_t sourceTime;
+
+	// Assets currently loaded, indexed by their filename
+	// The lock is only held to find, add or remove an asset, never while the geometry is read
+	static std::mutex assetsMutex;
+	static std::unordered_map<std::string, GeometryAsset*> assets;
+
+	GeometryAsset(const char *filename);
+	~GeometryAsset();
+
+	// Function to read the geometry if it is not held and count the caller as a holder waiting to upload it
+	// A failed read leaves the asset without data, so the next holder tries again
+	void AcquireData();
+
+	// Function to read the geometry from the cache, or import it and write the cache
+	void LoadData();
+
+	// Functions to take over the geometry of an asset loaded again from the file, and to give it up
+	void ReloadData();
+	void ReleaseData();
+
+	// Functions to import the model file and compute the bounds of its positions
+	void Import();
+	void ComputeBounds();
+
+	// Function to simplify the imported mesh into the levels of detail and append their indices
+	void GenerateLods();
+
+	// Functions to read and write the binary cache, a missing, stale or broken cache is only reported by returning false
+	bool LoadCache(std::string cachePath, uint64_t sourceSize, int64_t sourceTime);
+	bool WriteCache(std::string cachePath, uint64_t sourceSize, int64_t sourceTime);
+
+public:
+	// Function to get the asset of a file, importing it on first use
+	// Files are read concurrently, loads of a file being read wait for that read and share its result
+	// Every call has to be matched by a call to Release
+	static GeometryAsset *Load(const char *filename);
+
+	// Function to get the path of the binary cache of a model file
+	static std::string GetCachePath(const char *filename);
+
+	// Function to give up a reference, the asset is deleted with the last one
+	void Release();
+
+	// Function to tell that a holder has uploaded the geometry or no longer needs it on the CPU
+	// Every call to Load has to be matched by one call, with the last one the geometry is released if asked for
+	void FinishUpload(bool releaseData);
+
+	// Function to check whether the vertices, indices and positions are held in memory
+	bool IsDataLoaded();
+
+	// Function to get the number of bytes of the asset held in memory, including the cache mapping
+	size_t GetMemoryUsage();
+
+	std::string GetFilename();
+	std::string GetMaterialFilename();
+	bool IsLoadedFromCache();
+	float GetImportACMR();
+	float GetOptimizedACMR();
+
+	// The arrays are shared by every holder of the asset and must not be modified
+	Vertex *GetVertices();
+	size_t GetVertexCount();
+	uint32_t *GetIndices();
+	size_t GetIndexCount();
+	PositionView GetPositions();
+
+	// Bounds of the positions
+	Vec3 GetMinPosition();
+	Vec3 GetMaxPosition();
+
+	// Functions to get the levels of detail, level zero is the full mesh
+	int GetLodCount();
+	MeshLod GetLod(int lod);
+
+	// Function to get the distinct positions used by a level of detail
+	void GetLodPositions(int lod, std::vector<Vec3> &lodPositions);
+};
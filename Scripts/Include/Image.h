@@ -13,6 +13,9 @@ public:
 	// Memory for Texture Image
 	VkDeviceMemory memory;
 
+	// Size of the memory allocated for the image
+	VkDeviceSize allocationSize;
+
 	// Texture Image View
 	VkImageView imageView;
 
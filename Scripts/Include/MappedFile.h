@@ -0,0 +1,28 @@
+#pragma once
+#include <cstddef>
+
+// Read only view of a whole file mapped into memory
+// The pages are loaded by the operating system as they are touched, so nothing is copied up front
+class MappedFile
+{
+private:
+	const char *data;
+	size_t size;
+
+#ifdef _WIN32
+	void *fileHandle;
+	void *mappingHandle;
+#else
+	int fileDescriptor;
+#endif
+
+public:
+	MappedFile(const char *filename);
+	~MappedFile();
+
+	MappedFile(const MappedFile &) = delete;
+	MappedFile &operator=(const MappedFile &) = delete;
+
+	const char *GetData();
+	size_t GetSize();
+};
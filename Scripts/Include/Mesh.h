@@ -6,7 +6,9 @@
 #include "Pipeline.h"
 #include "TextureImage.h"
 #include "Window.h"
-#include "CollisionEngine\Collider.h"
+#include "CollisionWorld.h"
+#include "GeometryAsset.h"
+#include "VertexPacker.h"
 #include <vector>
 
 // Uniforms for model, view, projection transformations
@@ -14,6 +16,22 @@ struct UniformBufferObject {
 	glm::mat4 model;
 	glm::mat4 view;
 	glm::mat4 proj;
+
+	// Scale and offset of the stored positions, only read by the packed vertex shader
+	glm::vec4 positionScale;
+	glm::vec4 positionOffset;
+};
+
+// Level of detail whose positions build the collision body, zero for the full mesh
+// A coarser level gives a smaller collision proxy, levels missing from the asset fall back to the coarsest one
+const int COLLISION_PROXY_LOD = 0;
+
+// Bytes of memory held by a mesh, the geometry asset is shared with the other meshes of the same file
+struct MeshMemoryUsage
+{
+	size_t hostBytes;
+	size_t sharedHostBytes;
+	VkDeviceSize deviceBytes;
 };
 
 // Uniform for Lighting Constants
@@ -28,9 +46,15 @@ class Mesh
 {
 private:
 	bool isStatic;
+
+	// Set once the buffers of the mesh are on the device, only read and written by the render thread
+	bool isReady;
 	Vec3 position;
+
+	// Rotation last applied to the mesh and its collider, static meshes keep the rotation they had
+	glm::mat4 rotationMatrix;
 	Device *device;
-	Collider* collider;
+	CollisionBody* collisionBody;
 	CommandPool *commandPool;
 	// Vertices of the mesh
 	std::vector<Vertex> aabbVertices;
@@ -38,17 +62,40 @@ private:
 	// Indices of the faces of the mesh
 	std::vector<int> aabbIndices;
 
+	// Number of AABB indices, kept for drawing once the arrays are released
+	uint32_t aabbIndexCount;
+
+	// Layout of the vertex buffers
+	VertexFormat vertexFormat;
+
+	// Vertices of the mesh and of the AABB in the packed layout, prepared on load and freed once uploaded
+	std::vector<uint8_t> packedVertices;
+	std::vector<uint8_t> packedAABBVertices;
+
+	// Mapping of the stored positions back to model positions
+	VertexDequantization dequantization;
+	VertexDequantization aabbDequantization;
+
+	// Function to pack the vertices of the mesh and of the AABB into the vertex format
+	void PackVertices();
+
+	// Function to drop the arrays only needed for the upload, in memory budget mode also the shared geometry
+	void ReleaseUploadData();
+
+	// Level of detail drawn in the last frame
+	int currentLod;
+
+	// Function to pick the coarsest level of detail whose error projects to at most the pixel error of the UI
+	int SelectLod(glm::mat4 modelView, float screenHeight);
+
 	std::vector<VkDescriptorSet> CreateObjectDescriptorSets(VkDescriptorSetLayout descriptorSetLayout,
 		VkDescriptorPool descriptorPool,
 		std::vector<Buffer*>uniformBuffers, std::vector<Buffer*> lightingBuffers,
 		TextureImage *opacityTexture);
 
 public:
-	// Vertices of the mesh
-	std::vector<Vertex> vertices;
-
-	// Indices of the faces of the mesh
-	std::vector<int> indices;
+	// Vertices and indices of the mesh, shared with the other meshes of the same file
+	GeometryAsset *geometry;
 
 	// Lighting Constants of the mesh
 	LightingConstants lightingConstants;
@@ -95,16 +142,38 @@ public:
 	// Lighting Buffers
 	std::vector<Buffer*> aabbLightingBuffers;
 
+	// Indirect draw commands, rewritten every frame with the range of the selected level of detail
+	std::vector<Buffer*> drawCommandBuffers;
+
 	int swapChainCount;
 
 	Mesh();
-	Mesh(const char* filename, Vec3 position, Device *device, CommandPool *commandPool,int swapChainCount);
+	Mesh(const char* filename, Vec3 position, Device *device, CommandPool *commandPool,int swapChainCount, CollisionWorld *collisionWorld);
+
+	// Constructor of a mesh whose asset is loaded and uploaded later, usually by an AssetLoader
+	Mesh(Vec3 position, Device *device, CommandPool *commandPool, int swapChainCount);
 	~Mesh();
-	// Function to parse a obj file
-	void ParseObjFile(const char* filename);
+
+	// Function to load the geometry and build the collision body, safe to call on a worker thread
+	void LoadAsset(const char* filename, CollisionWorld *collisionWorld);
+
+	// Function to create the device buffers and textures of a loaded mesh, called on the render thread
+	void Upload();
+
+	// Function to check whether the mesh is uploaded and can be drawn
+	bool IsReady();
+
+	// Function to get the level of detail drawn in the last frame
+	int GetCurrentLod();
+
+	// Function to get the memory held by the mesh in RAM and on the device
+	MeshMemoryUsage GetMemoryUsage();
+
+	// Function to get the geometry of a obj file, parsing it only if no other mesh holds it
+	void LoadGeometry(const char* filename);
 
 	// Function to construct AABB mesh
-	void ConstructAABBMesh();
+	void ConstructAABBMesh(CollisionWorld *collisionWorld);
 
 	// Function to load properties from a MTL file
 	void LoadMaterial(const char* filename);
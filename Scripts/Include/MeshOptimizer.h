@@ -0,0 +1,43 @@
+#pragma once
+#include <cstdint>
+#include <vector>
+#include "vertex.h"
+
+// Size of the post transform vertex cache the triangles are ordered for and measured with
+const int VERTEX_CACHE_SIZE = 16;
+
+// Largest increase of the cache miss ratio accepted in exchange for a better overdraw order
+const float OVERDRAW_THRESHOLD = 1.05f;
+
+// Reorders the triangles and vertices of an indexed mesh for the GPU, the rendered mesh is unchanged
+// Triangles are ordered for the vertex cache with Tipsify, the resulting clusters are then sorted
+// so that outward facing clusters come first to reduce overdraw, and the vertices are finally
+// ordered by first use so that vertex fetches are sequential
+class MeshOptimizer
+{
+private:
+	// Function to order the triangles with Tipsify, the cluster boundaries are the triangles starting a new cluster
+	static void OptimizeVertexCache(std::vector<uint32_t> &indices, size_t vertexCount, std::vector<size_t> &clusters);
+
+	// Function to split the clusters further where the split costs few cache misses
+	static void SplitClusters(std::vector<uint32_t> &indices, size_t vertexCount, std::vector<size_t> &clusters);
+
+	// Function to sort the clusters from the outside of the mesh inwards
+	static void OptimizeOverdraw(std::vector<uint32_t> &indices, const Vertex *vertices, std::vector<size_t> &clusters);
+
+	// Function to count the cache misses of a range of triangles starting from an empty FIFO cache
+	static size_t CountCacheMisses(const uint32_t *indices, size_t indexCount, std::vector<size_t> &timestamps, size_t &time);
+
+public:
+	// Function to optimize the triangle and vertex order of a mesh
+	static void Optimize(std::vector<Vertex> &vertices, std::vector<uint32_t> &indices);
+
+	// Function to optimize the triangle order only, for index lists sharing a vertex buffer
+	static void OptimizeTriangles(const std::vector<Vertex> &vertices, std::vector<uint32_t> &indices);
+
+	// Function to order the vertices by their first use and remap the indices
+	static void OptimizeVertexFetch(std::vector<Vertex> &vertices, std::vector<uint32_t> &indices);
+
+	// Function to get the average cache miss ratio, the transformed vertices per triangle with a FIFO cache of VERTEX_CACHE_SIZE
+	static float GetACMR(const uint32_t *indices, size_t indexCount, size_t vertexCount);
+};
@@ -0,0 +1,34 @@
+#pragma once
+#include <cstdint>
+#include <vector>
+#include "vertex.h"
+
+// Error quadric of a set of planes, the sum of the squared distances to the planes weighted by their area
+struct Quadric
+{
+	double a00, a01, a02, a11, a12, a22;
+	double b0, b1, b2;
+	double c;
+	double weight;
+
+	// Function to add the plane of a triangle
+	void AddPlane(Vec3 normal, float distance, float area);
+	void Add(Quadric &other);
+
+	// Function to get the mean squared distance of a point to the planes
+	double GetError(Vec3 position);
+};
+
+// Simplifies an indexed mesh with quadric error metrics by collapsing edges onto one of their vertices
+// No vertices are moved or added, so every level of detail shares the vertex buffer of the full mesh
+// Vertices on a border, a non manifold edge or an attribute seam are never collapsed, so the outline and the
+// texture coordinates of the mesh are kept
+class MeshSimplifier
+{
+public:
+	// Function to simplify the triangles towards the target index count, collapsing edges only while the error
+	// stays below the largest error, a distance in model units
+	// Returns the largest error reached, the simplified triangles are written to the destination
+	static float Simplify(const Vertex *vertices, size_t vertexCount, const std::vector<uint32_t> &indices,
+		size_t targetIndexCount, float maxError, std::vector<uint32_t> &destination);
+};
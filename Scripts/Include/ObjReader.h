@@ -0,0 +1,194 @@
+#pragma once
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+#include "vertex.h"
+
+// Files smaller than this per thread are parsed by fewer threads, down to a single one
+const size_t OBJ_MIN_CHUNK_SIZE = 256 * 1024;
+
+// Number of elements of an obj file found by the quick scan before parsing
+// Corners and triangles are upper bounds, they are only used to reserve the arrays
+struct ObjCounts
+{
+	size_t positionCount;
+	size_t normalCount;
+	size_t texCoordCount;
+	size_t faceCount;
+	size_t cornerCount;
+	size_t triangleCount;
+};
+
+// Zero based position, texture coordinate and normal index of a face corner, -1 if missing
+struct ObjCorner
+{
+	int position;
+	int tex;
+	int normal;
+
+	bool operator==(const ObjCorner &other) const
+	{
+		return position == other.position && tex == other.tex && normal == other.normal;
+	}
+};
+
+// Hash of a corner, corners with the same hash are still told apart by comparing all three indices
+struct ObjCornerHash
+{
+	size_t operator()(const ObjCorner &corner) const
+	{
+		return (size_t)((uint32_t)corner.position ^ ((uint64_t)(uint32_t)corner.tex << 21) ^ ((uint64_t)(uint32_t)corner.normal << 42));
+	}
+};
+
+// Component of a corner given relative to the elements before it, which has to be offset by the elements of the earlier chunks
+struct ObjIndexFixup
+{
+	int corner;
+	int component;
+};
+
+// Part of an obj file made of whole lines, parsed concurrently with the other chunks
+// Elements and faces are kept per chunk, positive indices are global already and relative ones are fixed up afterwards
+class ObjChunk
+{
+private:
+	const char *begin;
+	const char *cursor;
+	const char *end;
+
+	// Function to count the elements so that the arrays are only allocated once
+	ObjCounts CountElements();
+
+	// Functions to move the cursor over the current line
+	void SkipSpaces();
+	void SkipLine();
+	bool IsLineEnd();
+	std::string ReadRestOfLine();
+
+	// Functions to read numbers at the cursor
+	float ReadFloat();
+	Vec3 ReadVector();
+	bool ReadIndex(int &index);
+
+	// Function to turn an index as written into a zero based one, listing relative indices for the fixup
+	int GetCornerIndex(int index, size_t localCount, int component);
+
+	// Function to read the corners of a face and add its triangles
+	void ReadFace();
+
+public:
+	std::vector<Vec3> positions;
+	std::vector<Vec3> normals;
+	std::vector<Vec3> texCoords;
+	std::vector<ObjCorner> corners;
+
+	// Corners of the triangles, three per triangle
+	std::vector<int> triangleCorners;
+	std::vector<ObjIndexFixup> fixups;
+
+	// Material library named by the chunk, empty if there is none
+	std::string materialFilename;
+
+	// Number of elements in the earlier chunks
+	size_t positionOffset;
+	size_t normalOffset;
+	size_t texCoordOffset;
+	size_t indexOffset;
+
+	// Distinct corners of the chunk in order of first use, and the triangles over them
+	std::vector<ObjCorner> vertexCorners;
+	std::vector<uint32_t> indices;
+
+	ObjChunk(const char *begin, const char *end);
+
+	// Function to parse the lines of the chunk
+	void Parse();
+
+	// Function to apply the fixups, check the indices and find the distinct corners of the chunk
+	void Resolve(size_t positionCount, size_t texCoordCount, size_t normalCount);
+};
+
+// Threads shared by every reader to parse the chunks, started on first use with one thread less than the hardware threads
+// Readers run on the asset loader workers, so they queue their chunks here instead of starting threads of their own,
+// which keeps the number of parsing threads fixed however many files are read at once
+// A reader waiting on its chunks runs queued chunks itself, so it never waits on a busy pool or on a pool without threads
+class ObjChunkPool
+{
+private:
+	std::vector<std::thread> threads;
+	std::deque<std::function<void()>> tasks;
+	bool isStopping;
+
+	std::mutex tasksMutex;
+	std::condition_variable tasksCondition;
+
+	ObjChunkPool(int threadCount);
+
+	// Function to run the first queued task with the lock released, and to wake the readers waiting on their chunks
+	void RunTask(std::unique_lock<std::mutex> &lock);
+
+	// Function run by every thread of the pool
+	void WorkerLoop();
+
+public:
+	~ObjChunkPool();
+
+	static ObjChunkPool *GetInstance();
+
+	// Function to queue a task, the task must not throw
+	void Push(std::function<void()> task);
+
+	// Function to run queued tasks on the calling thread until the pending count drops to zero
+	// The tasks lower the count themselves once they are done
+	void RunUntilDone(std::atomic<size_t> &pendingCount);
+};
+
+// Tokenizer for obj files held in memory, usually a mapped file
+// The file is split at line boundaries into chunks that are parsed concurrently, lines are scanned in place
+// and numbers are read with from_chars, so no strings are built while parsing
+// Faces with more than three corners are split into a fan of triangles
+// Corners sharing the same position, texture coordinate and normal share one vertex
+// The results do not depend on the number of threads
+class ObjReader
+{
+private:
+	const char *begin;
+	const char *end;
+
+	std::vector<ObjChunk> chunks;
+
+	// Elements of the whole file, gathered from the chunks
+	std::vector<Vec3> positions;
+	std::vector<Vec3> normals;
+	std::vector<Vec3> texCoords;
+
+	// Material library named by the file, empty if there is none
+	std::string materialFilename;
+
+	// Function to split the file into chunks of whole lines
+	void SplitChunks(int threadCount);
+
+	// Function to run a step on every chunk, the chunks past the first are queued on the shared chunk pool
+	template <typename Step>
+	void RunChunks(Step step);
+
+public:
+	ObjReader(const char *data, size_t size);
+
+	// Function to parse the whole file into the distinct vertices and the triangle indices
+	// The file is split into at most as many chunks as the thread count, a thread count of zero uses every hardware thread
+	void Parse(std::vector<Vertex> &vertices, std::vector<uint32_t> &indices, int threadCount = 0);
+
+	std::string GetMaterialFilename();
+
+	// Positions of the file in the order they are listed
+	std::vector<Vec3> &GetPositions();
+};
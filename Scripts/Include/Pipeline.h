@@ -1,5 +1,6 @@
 #pragma once
 #include "Swapchain.h"
+#include "VertexPacker.h"
 
 struct AdditionalPipelineParams
 {
@@ -7,6 +8,7 @@ struct AdditionalPipelineParams
 	VkBool32 StencilTestEnable;
 	VkBool32 ColorBlendEnable;
 	int SubPass;
+	VertexFormat InputVertexFormat;
 };
 
 struct OptionalPipelineParams
@@ -54,7 +56,7 @@ private:
 	VkPipeline pipeline;
 
 	void CreateShaderStages(std::unordered_map<VkShaderStageFlagBits, std::string> shaderMap);
-	void CreateVertexInputInfo();
+	void CreateVertexInputInfo(VertexFormat vertexFormat);
 	void CreateInputAssemblyInfo(VkPrimitiveTopology topology);
 	void CreateViewportStateInfo(Swapchain *swapChain);
 	VkViewport CreateViewport(Swapchain *swapChain);
@@ -0,0 +1,53 @@
+#pragma once
+#include <vector>
+#include <cstddef>
+#include "Matrix3.h"
+
+// Read only view of positions stored per axis, the positions are read in place and never copied
+// Positions stored one after the other as Vec3 are viewed with a stride of three floats
+struct PositionView
+{
+	const float *x;
+	const float *y;
+	const float *z;
+	size_t stride;
+	size_t count;
+
+	PositionView()
+	{
+		x = y = z = nullptr;
+		stride = 1;
+		count = 0;
+	}
+
+	// Constructor of a view over separate x, y and z arrays
+	PositionView(const float *x, const float *y, const float *z, size_t count)
+	{
+		this->x = x;
+		this->y = y;
+		this->z = z;
+		stride = 1;
+		this->count = count;
+	}
+
+	// Constructor of a view over an array of Vec3, so that every consumer of a view also takes a vector
+	PositionView(const std::vector<Vec3> &positions)
+	{
+		const float *first = (const float*)positions.data();
+		x = first;
+		y = first + 1;
+		z = first + 2;
+		stride = sizeof(Vec3) / sizeof(float);
+		count = positions.size();
+	}
+
+	size_t size() const
+	{
+		return count;
+	}
+
+	Vec3 operator[](size_t i) const
+	{
+		return Vec3(x[i * stride], y[i * stride], z[i * stride]);
+	}
+};
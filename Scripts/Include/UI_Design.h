@@ -7,6 +7,9 @@ struct UIParameters
 {
 	float scale;
 	bool isCollisionEnabled;
+	float collisionBudget;
+	float uploadBudget;
+	float lodPixelError;
 	bool renderAABB;
 };
 
@@ -0,0 +1,60 @@
+#pragma once
+#include <cstdint>
+#include <vector>
+#include "vertex.h"
+
+// Layout of the vertices in the vertex buffers
+// The packed layouts drop the colour, which is always white, store the normal octahedral encoded in two snorm16
+// and the texture coordinates as two half floats
+// The quantized layout also stores the position as snorm16 relative to the bounds of the mesh
+enum VertexFormat
+{
+	VERTEX_FORMAT_FULL,
+	VERTEX_FORMAT_PACKED,
+	VERTEX_FORMAT_QUANTIZED
+};
+
+// Vertex with float positions, 20 bytes
+struct PackedVertex
+{
+	float position[3];
+	int16_t normal[2];
+	uint16_t tex[2];
+};
+
+// Vertex with quantized positions, 16 bytes, the fourth position component only pads the attribute to four components
+struct QuantizedVertex
+{
+	int16_t position[4];
+	int16_t normal[2];
+	uint16_t tex[2];
+};
+
+// Scale and offset that turn the stored positions back into model positions, position = stored * scale + offset
+struct VertexDequantization
+{
+	Vec3 scale;
+	Vec3 offset;
+};
+
+// Converts vertices into the packed layouts read by the packed vertex shader
+class VertexPacker
+{
+private:
+	// Functions to encode single values
+	static int16_t EncodeSnorm16(float value);
+	static uint16_t EncodeHalf(float value);
+	static void EncodeOctahedral(Vec3 normal, int16_t encoded[2]);
+
+public:
+	// Function to get the size of a vertex in the given format
+	static size_t GetVertexSize(VertexFormat format);
+
+	// Function to pack vertices into the given format, the positions are quantized within the given bounds
+	// Returns how the stored positions map back to model positions
+	static VertexDequantization PackVertices(const Vertex *vertices, size_t vertexCount, VertexFormat format,
+		Vec3 minPosition, Vec3 maxPosition, std::vector<uint8_t> &packedVertices);
+
+	// Function to get the bounds of the positions of the vertices
+	static void GetBounds(const Vertex *vertices, size_t vertexCount, Vec3 &minPosition, Vec3 &maxPosition);
+};
@@ -1,7 +1,6 @@
 #include "Application.h"
 #include "UI_Design.h"
 #include "Debug.h"
-#include "CollisionEngine\CollisionEngine.h"
 // Constructor
 Application::Application()
 {
@@ -66,24 +65,32 @@ void Application::initVulkan() {
 	// Create Frame Buffers
 	createFramebuffers();
 
-	// Parse the Object file
-	ball = Mesh(MODEL,Vec3(-40,0,0), device,commandPool,swapChain->swapChainImages.size());
+	// Create the collision world
+	// Colliders move opposite to the meshes, so the camera position is negated as well
+	collisionWorld = new CollisionWorld();
+	collisionWorld->SetViewPosition(Vec3(0.0f, 2.0f, 100.0f) * -1);
 
-	ball2 = Mesh(MODEL, Vec3(40, 0, 0), device, commandPool, swapChain->swapChainImages.size());
+	// Queue the Object files, they are parsed in the background and drawn once uploaded
+	assetLoader = new AssetLoader();
+
+	meshes.push_back(new Mesh(Vec3(-40, 0, 0), device, commandPool, swapChain->swapChainImages.size()));
+
+	meshes.push_back(new Mesh(Vec3(40, 0, 0), device, commandPool, swapChain->swapChainImages.size()));
+	meshes[1]->SetStatic(true);
+
+	for (auto mesh : meshes)
+	{
+		assetLoader->LoadMesh(mesh, MODEL, collisionWorld);
+	}
 
 	// Create the Descriptor Pool to create descriptor sets
-	descriptorPool = createDescriptorPool(swapChain->swapChainImages.size() * 4, {
+	// Every mesh takes a set for itself and one for its AABB per swap chain image
+	descriptorPool = createDescriptorPool(swapChain->swapChainImages.size() * 2 * meshes.size(), {
 		VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER,
 		VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER,
 		VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER
 		});
 
-	// Create descriptor sets
-	ball.createDescriptorSets(descriptorSetLayout, descriptorPool);
-
-	ball2.createDescriptorSets(descriptorSetLayout, descriptorPool);
-	ball2.SetStatic(true);
-
 	// Create Command Buffers
 	createCommandBuffers();
 
@@ -97,9 +104,12 @@ void Application::mainLoop() {
 
 	// Event loop to keep the application running until there is an error or window is closed
 	while (!glfwWindowShouldClose(window.GetGLFWWindow())) {
-		CollisionEngine::GetInstance()->SetActive(UIDesign::uiParams.isCollisionEnabled);
+		collisionWorld->SetActive(UIDesign::uiParams.isCollisionEnabled);
+
+		collisionWorld->CollisionLoop(UIDesign::uiParams.collisionBudget);
 
-		CollisionEngine::GetInstance()->CollisionLoop();
+		// Upload the meshes loaded in the background
+		uploadLoadedMeshes();
 
 		// Checks for events like Window close by the user
 		glfwPollEvents();
@@ -118,14 +128,53 @@ void Application::mainLoop() {
 	vkDeviceWaitIdle(device->logicalDevice);
 }
 
+// Function to upload the meshes loaded in the background within the upload budget
+// The command buffers are prerecorded, so they are recorded again to draw the new meshes
+void Application::uploadLoadedMeshes() {
+	std::vector<Mesh*> uploaded;
+	assetLoader->UploadLoaded(UIDesign::uiParams.uploadBudget, uploaded);
+	if (uploaded.empty())
+		return;
+
+	for (auto mesh : uploaded)
+	{
+		mesh->createDescriptorSets(descriptorSetLayout, descriptorPool);
+
+		// Report the memory of the mesh, the geometry asset is shared by every mesh of the same file
+		if (PRINT_MESH_STATISTICS)
+		{
+			MeshMemoryUsage usage = mesh->GetMemoryUsage();
+			std::cout << "Mesh " << std::find(meshes.begin(), meshes.end(), mesh) - meshes.begin() << ": "
+				<< usage.hostBytes / 1024.0 << " KB RAM, " << usage.sharedHostBytes / 1024.0 << " KB shared geometry, "
+				<< usage.deviceBytes / 1024.0 << " KB VRAM" << std::endl;
+		}
+	}
+
+	// Wait for the frames in flight to stop using the command buffers
+	vkDeviceWaitIdle(device->logicalDevice);
+	vkFreeCommandBuffers(device->logicalDevice, commandPool->commandPool, static_cast<uint32_t>(commandBuffers.size()), commandBuffers.data());
+	createCommandBuffers();
+}
+
 // Function to destroy all Vulkan objects and free allocated resources
 void Application::cleanup() {
 
+	// Stop loading before the meshes are destroyed
+	assetLoader->Stop();
+	delete assetLoader;
+
 	// Cleanup swap chain
 	cleanupSwapChain();
 
-	ball.Cleanup();
-	ball2.Cleanup();
+	for (auto mesh : meshes)
+	{
+		mesh->Cleanup();
+		delete mesh;
+	}
+
+	// The world deletes the collision bodies of the meshes
+	delete collisionWorld;
+
 	// Destroy the descriptor sets
 	vkDestroyDescriptorSetLayout(device->logicalDevice, descriptorSetLayout, nullptr);
 
@@ -375,7 +424,7 @@ void Application::createRenderPass() {
 void Application::createGraphicsPipeline() 
 {
 	std::unordered_map<VkShaderStageFlagBits, std::string> graphicsShaderMap;
-	graphicsShaderMap.emplace(VK_SHADER_STAGE_VERTEX_BIT, "shaders/vert.spv");
+	graphicsShaderMap.emplace(VK_SHADER_STAGE_VERTEX_BIT, MESH_VERTEX_FORMAT == VERTEX_FORMAT_FULL ? "shaders/vert.spv" : PACKED_VERTEX_SHADER);
 	graphicsShaderMap.emplace(VK_SHADER_STAGE_FRAGMENT_BIT, "shaders/frag.spv");
 
 	AdditionalPipelineParams additionalParams = {};
@@ -383,6 +432,7 @@ void Application::createGraphicsPipeline()
 	additionalParams.StencilTestEnable = VK_FALSE;
 	additionalParams.ColorBlendEnable = VK_TRUE;
 	additionalParams.SubPass = 0;
+	additionalParams.InputVertexFormat = MESH_VERTEX_FORMAT;
 
 	graphicsPipeline.CreatePipeline(device, swapChain, renderPass, descriptorSetLayout,
 		graphicsShaderMap,additionalParams);
@@ -543,13 +593,18 @@ void Application::createCommandBuffers() {
 		
 		VkDeviceSize offsets[] = { 0 };
 
-		ball.Draw(commandBuffers[i],graphicsPipeline,i);
-
-		ball2.Draw(commandBuffers[i], graphicsPipeline, i);
-
-		ball.DrawAABB(commandBuffers[i], graphicsPipeline, i);
+		// Meshes still loading are left out until they are uploaded
+		for (auto mesh : meshes)
+		{
+			if (mesh->IsReady())
+				mesh->Draw(commandBuffers[i], graphicsPipeline, i);
+		}
 
-		ball2.DrawAABB(commandBuffers[i], graphicsPipeline, i);
+		for (auto mesh : meshes)
+		{
+			if (mesh->IsReady())
+				mesh->DrawAABB(commandBuffers[i], graphicsPipeline, i);
+		}
 
 		// End the render pass recording
 		vkCmdEndRenderPass(commandBuffers[i]);
@@ -757,12 +812,14 @@ void Application::drawFrame() {
 	imagesInFlight[imageIndex] = inFlightFences[currentFrame];
 
 	// Update the uniform buffer to have the current model view projection matrices
-	ball.updateUniformBuffer(imageIndex, window, swapChain);
-	ball2.updateUniformBuffer(imageIndex, window, swapChain);
-
 	// Update the uniform buffer to have the current ambient, specular, diffuse values
-	ball.updateLightingConstants(imageIndex, window, swapChain);
-	ball2.updateLightingConstants(imageIndex, window, swapChain);
+	for (auto mesh : meshes)
+	{
+		if (!mesh->IsReady())
+			continue;
+		mesh->updateUniformBuffer(imageIndex, window, swapChain);
+		mesh->updateLightingConstants(imageIndex, window, swapChain);
+	}
 
 	imGui->RenderImGUI(device, swapChain->swapChainExtent, imageIndex);
 
@@ -886,17 +943,24 @@ void Application::recreateSwapChain() {
 	createFramebuffers();
 
 	// Recreate uniform buffers
-	ball.createUniformBuffers();
-	ball2.createUniformBuffers();
+	// Meshes still loading create theirs when they are uploaded
+	for (auto mesh : meshes)
+	{
+		if (mesh->IsReady())
+			mesh->createUniformBuffers();
+	}
 	// Recreate the descriptor sets
 
-	descriptorPool = createDescriptorPool(swapChain->swapChainImages.size() * 4, {
+	descriptorPool = createDescriptorPool(swapChain->swapChainImages.size() * 2 * meshes.size(), {
 		VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER,
 		VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER,
 		VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER
 		});
-	ball.createDescriptorSets(descriptorSetLayout, descriptorPool);
-	ball2.createDescriptorSets(descriptorSetLayout, descriptorPool);
+	for (auto mesh : meshes)
+	{
+		if (mesh->IsReady())
+			mesh->createDescriptorSets(descriptorSetLayout, descriptorPool);
+	}
 	// Create command buffers
 	createCommandBuffers();
 
@@ -923,8 +987,11 @@ void Application::cleanupSwapChain() {
 
 	swapChain->Cleanup(device);
 
-	ball.CleanupUniformBuffers();
-	ball2.CleanupUniformBuffers();
+	for (auto mesh : meshes)
+	{
+		if (mesh->IsReady())
+			mesh->CleanupUniformBuffers();
+	}
 	// Destroy the descriptor pool
 	vkDestroyDescriptorPool(device->logicalDevice, descriptorPool, nullptr);
 
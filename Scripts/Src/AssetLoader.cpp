@@ -0,0 +1,120 @@
+#include "AssetLoader.h"
+#include <chrono>
+
+AssetLoader::AssetLoader(int threadCount)
+{
+	activeCount = 0;
+	isStopping = false;
+
+	// Leave one hardware thread to the render thread
+	if (threadCount <= 0)
+	{
+		threadCount = (int)std::thread::hardware_concurrency() - 1;
+		if (threadCount <= 0)
+			threadCount = DEFAULT_ASSET_LOADER_THREADS;
+	}
+
+	for (int i = 0; i < threadCount; i++)
+	{
+		workers.push_back(std::thread(&AssetLoader::WorkerLoop, this));
+	}
+}
+
+AssetLoader::~AssetLoader()
+{
+	Stop();
+}
+
+void AssetLoader::WorkerLoop()
+{
+	while (true)
+	{
+		AssetRequest request;
+		{
+			std::unique_lock<std::mutex> lock(requestsMutex);
+			requestsCondition.wait(lock, [this] { return isStopping || !pendingRequests.empty(); });
+			if (isStopping)
+				return;
+			request = pendingRequests.front();
+			pendingRequests.pop_front();
+			activeCount++;
+		}
+
+		try
+		{
+			request.mesh->LoadAsset(request.filename.c_str(), request.collisionWorld);
+		}
+		catch (...)
+		{
+			request.error = std::current_exception();
+		}
+
+		std::lock_guard<std::mutex> lock(requestsMutex);
+		activeCount--;
+		loadedRequests.push_back(request);
+	}
+}
+
+void AssetLoader::LoadMesh(Mesh *mesh, std::string filename, CollisionWorld *collisionWorld)
+{
+	AssetRequest request;
+	request.mesh = mesh;
+	request.filename = filename;
+	request.collisionWorld = collisionWorld;
+	{
+		std::lock_guard<std::mutex> lock(requestsMutex);
+		pendingRequests.push_back(request);
+	}
+	requestsCondition.notify_one();
+}
+
+void AssetLoader::UploadLoaded(double timeBudget, std::vector<Mesh*> &uploaded)
+{
+	auto start = std::chrono::steady_clock::now();
+	while (true)
+	{
+		AssetRequest request;
+		{
+			std::lock_guard<std::mutex> lock(requestsMutex);
+			if (loadedRequests.empty())
+				return;
+			request = loadedRequests.front();
+			loadedRequests.pop_front();
+		}
+
+		if (request.error)
+		{
+			std::rethrow_exception(request.error);
+		}
+
+		// The upload waits for the transfer queue, so the budget is checked between meshes
+		request.mesh->Upload();
+		uploaded.push_back(request.mesh);
+
+		double elapsed = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count();
+		if (elapsed >= timeBudget)
+			return;
+	}
+}
+
+bool AssetLoader::IsIdle()
+{
+	std::lock_guard<std::mutex> lock(requestsMutex);
+	return pendingRequests.empty() && loadedRequests.empty() && activeCount == 0;
+}
+
+void AssetLoader::Stop()
+{
+	{
+		std::lock_guard<std::mutex> lock(requestsMutex);
+		isStopping = true;
+		pendingRequests.clear();
+	}
+	requestsCondition.notify_all();
+
+	for (auto &worker : workers)
+	{
+		worker.join();
+	}
+	workers.clear();
+}
@@ -1,13 +1,13 @@
 #include "BindingAttributeDescriptionHelper.h"
 
 // Get Binding Description for the vertex
-std::vector<VkVertexInputBindingDescription> BindingAttributeDescriptionHelper::getBindingDescription() {
+std::vector<VkVertexInputBindingDescription> BindingAttributeDescriptionHelper::getBindingDescription(VertexFormat format) {
 	std::vector<VkVertexInputBindingDescription> bindingDescription = {};
 
 	bindingDescription.resize(2);
 
 	bindingDescription[0].binding = 0;
-	bindingDescription[0].stride = sizeof(Vertex);
+	bindingDescription[0].stride = static_cast<uint32_t>(VertexPacker::GetVertexSize(format));
 	bindingDescription[0].inputRate = VK_VERTEX_INPUT_RATE_VERTEX;
 
 	bindingDescription[1].binding = 1;
@@ -18,8 +18,39 @@ std::vector<VkVertexInputBindingDescription> BindingAttributeDescriptionHelper::
 }
 
 // Get the attribute descriptions
-std::vector<VkVertexInputAttributeDescription> BindingAttributeDescriptionHelper::getAttributeDescriptions() {
+std::vector<VkVertexInputAttributeDescription> BindingAttributeDescriptionHelper::getAttributeDescriptions(VertexFormat format) {
 	std::vector<VkVertexInputAttributeDescription> attributeDescriptions{};
+
+	// The packed layouts have no colour, so location 1 is left out
+	if (format == VERTEX_FORMAT_PACKED || format == VERTEX_FORMAT_QUANTIZED)
+	{
+		attributeDescriptions.resize(3);
+		attributeDescriptions[0].binding = 0;
+		attributeDescriptions[0].location = 0;
+		if (format == VERTEX_FORMAT_PACKED)
+		{
+			attributeDescriptions[0].format = VK_FORMAT_R32G32B32_SFLOAT;
+			attributeDescriptions[0].offset = offsetof(PackedVertex, position);
+		}
+		else
+		{
+			attributeDescriptions[0].format = VK_FORMAT_R16G16B16A16_SNORM;
+			attributeDescriptions[0].offset = offsetof(QuantizedVertex, position);
+		}
+
+		attributeDescriptions[1].binding = 0;
+		attributeDescriptions[1].location = 2;
+		attributeDescriptions[1].format = VK_FORMAT_R16G16_SFLOAT;
+		attributeDescriptions[1].offset = format == VERTEX_FORMAT_PACKED ? offsetof(PackedVertex, tex) : offsetof(QuantizedVertex, tex);
+
+		attributeDescriptions[2].binding = 0;
+		attributeDescriptions[2].location = 3;
+		attributeDescriptions[2].format = VK_FORMAT_R16G16_SNORM;
+		attributeDescriptions[2].offset = format == VERTEX_FORMAT_PACKED ? offsetof(PackedVertex, normal) : offsetof(QuantizedVertex, normal);
+
+		return attributeDescriptions;
+	}
+
 	attributeDescriptions.resize(4);
 	attributeDescriptions[0].binding = 0;
 	attributeDescriptions[0].location = 0;
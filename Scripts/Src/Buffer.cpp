@@ -18,6 +18,7 @@ Buffer::Buffer(Device *device, VkDeviceSize size, VkBufferUsageFlags usage, VkMe
 	allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
 	allocInfo.allocationSize = memRequirements.size;
 	allocInfo.memoryTypeIndex = device->findMemoryType(memRequirements.memoryTypeBits, properties);
+	allocationSize = memRequirements.size;
 
 	if (vkAllocateMemory(device->logicalDevice, &allocInfo, nullptr, &memory) != VK_SUCCESS) {
 		throw std::runtime_error("failed to allocate buffer memory!");
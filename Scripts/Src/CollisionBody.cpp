@@ -0,0 +1,356 @@
+#include "CollisionBody.h"
+#include "CollisionWorld.h"
+#include "CollisionEngine\CollisionEngine.h"
+#include <algorithm>
+#include <mutex>
+#include <stdexcept>
+
+// The library registers every collider in the map of its process wide engine, so registering is serialized
+// Only bodies that build a library collider take the lock
+static std::mutex colliderRegistryMutex;
+
+CollisionBody::CollisionBody(CollisionWorld *world, std::string name, PositionView vertices, int octreeDepth,
+	CollisionShape *sharedShape)
+{
+	Initialize(world, name);
+	compoundShape = nullptr;
+	isShapeShared = sharedShape != nullptr;
+
+	// A shared shape already summarizes the vertices, so the body does not build a library octree of its own
+	if (isShapeShared)
+	{
+		collider = nullptr;
+		shape = sharedShape;
+	}
+	else
+	{
+		CreateCollider(vertices, octreeDepth);
+		shape = CreateShape(vertices, octreeDepth);
+	}
+
+	world->AddBody(this);
+}
+
+CollisionBody::CollisionBody(CollisionWorld *world, std::string name, std::vector<std::vector<Vec3>> &parts,
+	std::vector<CollisionTransform> &localTransforms, int octreeDepth)
+{
+	Initialize(world, name);
+	compoundShape = new CompoundShape(parts, localTransforms, octreeDepth);
+
+	// Pairs of a compound body are final at the leaves of its parts, so a library octree over the merged parts would never be used
+	collider = nullptr;
+
+	// The point and batch queries run over a single shape, so they get the parts merged at their local transforms
+	std::vector<Vec3> vertices;
+	for (size_t i = 0; i < parts.size(); i++)
+	{
+		for (auto vertex : parts[i])
+		{
+			vertices.push_back(localTransforms[i].rotation.Rotate(vertex) + localTransforms[i].position);
+		}
+	}
+	shape = CreateShape(vertices, octreeDepth);
+	isShapeShared = false;
+
+	world->AddBody(this);
+}
+
+void CollisionBody::Initialize(CollisionWorld *world, std::string name)
+{
+	this->world = world;
+	this->name = name;
+	colliderName = world->GetColliderName(name);
+	handle = -1;
+	category = COLLISION_CATEGORY_DEFAULT;
+	mask = COLLISION_MASK_ALL;
+	isDeformed = false;
+}
+
+void CollisionBody::CreateCollider(PositionView vertices, int octreeDepth)
+{
+	std::vector<Vec3> colliderVertices(vertices.size());
+	for (size_t i = 0; i < vertices.size(); i++)
+	{
+		colliderVertices[i] = vertices[i];
+	}
+
+	std::lock_guard<std::mutex> lock(colliderRegistryMutex);
+	collider = new Collider(colliderName, std::move(colliderVertices), octreeDepth);
+}
+
+CollisionShape * CollisionBody::CreateShape(PositionView vertices, int octreeDepth)
+{
+	// Use the corners of the collider AABB as the root so that the cells match the library octree
+	// Without a collider the root is fitted to the vertices
+	std::vector<Vec3> aabbVertices;
+	PositionView rootVertices = vertices;
+	if (collider != nullptr)
+	{
+		aabbVertices = collider->GetAABB()->GetVertices();
+		rootVertices = aabbVertices;
+	}
+	Vec3 rootMin = rootVertices[0];
+	Vec3 rootMax = rootVertices[0];
+	for (size_t i = 0; i < rootVertices.size(); i++)
+	{
+		Vec3 vertex = rootVertices[i];
+		rootMin = Vec3(std::min(rootMin.x, vertex.x), std::min(rootMin.y, vertex.y), std::min(rootMin.z, vertex.z));
+		rootMax = Vec3(std::max(rootMax.x, vertex.x), std::max(rootMax.y, vertex.y), std::max(rootMax.z, vertex.z));
+	}
+	return new CollisionShape(vertices, rootMin, rootMax, octreeDepth);
+}
+
+CollisionBody::~CollisionBody()
+{
+	// Unregister the collider so that the library stops checking other colliders against it
+	if (collider != nullptr)
+	{
+		std::lock_guard<std::mutex> lock(colliderRegistryMutex);
+		CollisionEngine::GetInstance()->RemoveCollider(colliderName);
+	}
+	delete collider;
+
+	if (!isShapeShared)
+		delete shape;
+	delete compoundShape;
+}
+
+std::string CollisionBody::GetName()
+{
+	return name;
+}
+
+int CollisionBody::GetHandle()
+{
+	return handle;
+}
+
+void CollisionBody::SetHandle(int handle)
+{
+	this->handle = handle;
+}
+
+uint32_t CollisionBody::GetCategory()
+{
+	return category;
+}
+
+void CollisionBody::SetCategory(uint32_t category)
+{
+	this->category = category;
+}
+
+uint32_t CollisionBody::GetMask()
+{
+	return mask;
+}
+
+void CollisionBody::SetMask(uint32_t mask)
+{
+	this->mask = mask;
+}
+
+CollisionWorld * CollisionBody::GetWorld()
+{
+	return world;
+}
+
+Vec3 CollisionBody::GetPosition()
+{
+	return world->GetBodyPosition(handle);
+}
+
+CollisionRotation CollisionBody::GetRotation()
+{
+	return world->GetBodyRotation(handle);
+}
+
+CollisionTransform CollisionBody::GetTransform()
+{
+	CollisionTransform transform = { GetPosition(), GetRotation() };
+	return transform;
+}
+
+Collider * CollisionBody::GetCollider()
+{
+	return collider;
+}
+
+CollisionShape * CollisionBody::GetShape()
+{
+	return shape;
+}
+
+CompoundShape * CollisionBody::GetCompoundShape()
+{
+	return compoundShape;
+}
+
+bool CollisionBody::IsCompound()
+{
+	return compoundShape != nullptr;
+}
+
+bool CollisionBody::UsesColliderOctree()
+{
+	return collider != nullptr && !isDeformed && GetRotation().IsIdentity();
+}
+
+void CollisionBody::Translate(Vec3 translateVec)
+{
+	world->TranslateBody(this, translateVec);
+}
+
+void CollisionBody::SetPosition(Vec3 position)
+{
+	world->SetBodyPosition(this, position);
+}
+
+void CollisionBody::SetRotation(CollisionRotation rotation)
+{
+	world->SetBodyRotation(this, rotation);
+}
+
+void CollisionBody::UpdateVertices(std::vector<Vec3> vertices)
+{
+	if (compoundShape != nullptr)
+	{
+		throw std::runtime_error("vertices of a compound collision body cannot be updated!");
+	}
+	if (isShapeShared)
+	{
+		throw std::runtime_error("vertices of a collision body with a shared shape cannot be updated!");
+	}
+	world->UpdateBodyVertices(this, vertices);
+}
+
+void CollisionBody::SetQuantized(bool isQuantized)
+{
+	if (isShapeShared)
+	{
+		throw std::runtime_error("quantization of a collision body with a shared shape cannot be changed!");
+	}
+	shape->SetQuantized(isQuantized);
+	if (compoundShape != nullptr)
+		compoundShape->SetQuantized(isQuantized);
+}
+
+void CollisionBody::ApplyVertexUpdate(std::vector<Vec3> &vertices)
+{
+	shape->UpdateVertices(vertices);
+	isDeformed = true;
+}
+
+void CollisionBody::SyncCollider(Vec3 position)
+{
+	if (position.x == colliderPosition.x && position.y == colliderPosition.y && position.z == colliderPosition.z)
+		return;
+	collider->Translate(position - colliderPosition);
+	colliderPosition = position;
+}
+
+bool CollisionBody::IsCollidedWithAny()
+{
+	return world->GetContactCount(handle) > 0;
+}
+
+CollisionResult CollisionBody::CheckCollision(CollisionBody *otherBody, int maxDepth)
+{
+	CollisionTransform transform = GetTransform();
+	CollisionTransform otherTransform = otherBody->GetTransform();
+	CompoundShape *otherCompoundShape = otherBody->GetCompoundShape();
+	if (compoundShape != nullptr && otherCompoundShape != nullptr)
+		return compoundShape->CheckCollision(otherCompoundShape, transform, otherTransform, maxDepth);
+	if (compoundShape != nullptr)
+		return compoundShape->CheckCollision(otherBody->GetShape(), transform, otherTransform, maxDepth);
+	if (otherCompoundShape != nullptr)
+		return otherCompoundShape->CheckCollision(shape, otherTransform, transform, maxDepth);
+	return shape->CheckCollision(otherBody->GetShape(), transform, otherTransform, maxDepth);
+}
+
+void CollisionBody::CheckCollisionBatch(CollisionBody *otherBody, std::vector<Vec3> &otherPositions, std::vector<uint64_t> &results)
+{
+	CollisionRotation otherRotation = otherBody->GetRotation();
+	std::vector<CollisionTransform> otherTransforms(otherPositions.size());
+	for (size_t i = 0; i < otherPositions.size(); i++)
+	{
+		otherTransforms[i] = { otherPositions[i], otherRotation };
+	}
+	CheckCollisionBatch(otherBody, otherTransforms, results);
+}
+
+void CollisionBody::CheckCollisionBatch(CollisionBody *otherBody, std::vector<CollisionTransform> &otherTransforms, std::vector<uint64_t> &results)
+{
+	shape->CheckCollisionBatch(otherBody->GetShape(), GetTransform(), otherTransforms, results);
+}
+
+float CollisionBody::Distance(CollisionBody *otherBody, float maxDistance)
+{
+	return shape->Distance(otherBody->GetShape(), GetTransform(), otherBody->GetTransform(), maxDistance);
+}
+
+bool CollisionBody::IsWithinDistance(CollisionBody *otherBody, float distance)
+{
+	return shape->IsWithinDistance(otherBody->GetShape(), GetTransform(), otherBody->GetTransform(), distance);
+}
+
+// Point queries run in the frame of the body and the vertices found are placed back by its transform
+Vec3 CollisionBody::ClosestPoint(Vec3 point)
+{
+	CollisionTransform transform = GetTransform();
+	Vec3 localPoint = transform.rotation.RotateInverse(point - transform.position);
+	return transform.rotation.Rotate(shape->ClosestPoint(localPoint, Vec3())) + transform.position;
+}
+
+void CollisionBody::KNearest(Vec3 point, int k, std::vector<VertexNeighbor> &results)
+{
+	CollisionTransform transform = GetTransform();
+	shape->KNearest(transform.rotation.RotateInverse(point - transform.position), Vec3(), k, results);
+	PlaceNeighbors(transform, results);
+}
+
+void CollisionBody::KNearestBatch(std::vector<Vec3> &points, int k, std::vector<VertexNeighbor> &results)
+{
+	CollisionTransform transform = GetTransform();
+	std::vector<Vec3> localPoints(points.size());
+	for (size_t i = 0; i < points.size(); i++)
+	{
+		localPoints[i] = transform.rotation.RotateInverse(points[i] - transform.position);
+	}
+	shape->KNearestBatch(localPoints, Vec3(), k, results);
+	PlaceNeighbors(transform, results);
+}
+
+void CollisionBody::RadiusSearch(Vec3 point, float radius, std::vector<VertexNeighbor> &results)
+{
+	CollisionTransform transform = GetTransform();
+	shape->RadiusSearch(transform.rotation.RotateInverse(point - transform.position), Vec3(), radius, results);
+	PlaceNeighbors(transform, results);
+}
+
+void CollisionBody::PlaceNeighbors(CollisionTransform &transform, std::vector<VertexNeighbor> &neighbors)
+{
+	// Unused entries of a batch query have an infinite distance and no vertex to move
+	for (auto &neighbor : neighbors)
+	{
+		if (neighbor.distanceSquared == FLT_MAX)
+			continue;
+		neighbor.vertex = transform.rotation.Rotate(neighbor.vertex) + transform.position;
+	}
+}
+
+void CollisionBody::BeginContact(std::string otherName)
+{
+	if (collider != nullptr)
+		collider->CollidedObjects->push_back(otherName);
+}
+
+void CollisionBody::EndContact(std::string otherName)
+{
+	if (collider == nullptr)
+		return;
+	std::vector<std::string> *collidedObjects = collider->CollidedObjects;
+	auto it = std::find(collidedObjects->begin(), collidedObjects->end(), otherName);
+	if (it != collidedObjects->end())
+		collidedObjects->erase(it);
+}
@@ -0,0 +1,61 @@
+#include "CollisionCommandQueue.h"
+
+CollisionCommandQueue::CollisionCommandQueue()
+{
+	stub.next.store(nullptr, std::memory_order_relaxed);
+	head.store(&stub, std::memory_order_relaxed);
+	tail = &stub;
+}
+
+CollisionCommandQueue::~CollisionCommandQueue()
+{
+	while (CollisionCommand *command = Pop())
+	{
+		delete command;
+	}
+}
+
+void CollisionCommandQueue::Push(CollisionCommand *command)
+{
+	command->next.store(nullptr, std::memory_order_relaxed);
+
+	// Link the command after the previous head, the consumer waits for the link if it sees the new head first
+	CollisionCommand *previous = head.exchange(command, std::memory_order_acq_rel);
+	previous->next.store(command, std::memory_order_release);
+}
+
+CollisionCommand *CollisionCommandQueue::Pop()
+{
+	CollisionCommand *current = tail;
+	CollisionCommand *next = current->next.load(std::memory_order_acquire);
+
+	// Skip the stub
+	if (current == &stub)
+	{
+		if (next == nullptr)
+			return nullptr;
+		tail = next;
+		current = next;
+		next = next->next.load(std::memory_order_acquire);
+	}
+
+	if (next != nullptr)
+	{
+		tail = next;
+		return current;
+	}
+
+	// A producer has exchanged the head but not linked its command yet
+	if (current != head.load(std::memory_order_acquire))
+		return nullptr;
+
+	// The last command can only be popped once the stub is pushed behind it
+	Push(&stub);
+	next = current->next.load(std::memory_order_acquire);
+	if (next != nullptr)
+	{
+		tail = next;
+		return current;
+	}
+	return nullptr;
+}
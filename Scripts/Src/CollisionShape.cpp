@@ -0,0 +1,1532 @@
+#include "CollisionShape.h"
+#include <algorithm>
+#include <cfloat>
+#include <queue>
+#include <functional>
+#include <stdexcept>
+#include <emmintrin.h>
+
+// Function to interleave the bits of the cell coordinates into a morton code
+static uint64_t EncodeCell(uint64_t x, uint64_t y, uint64_t z, int depth)
+{
+	uint64_t code = 0;
+	for (int i = 0; i < depth; i++)
+	{
+		code |= ((x >> i) & 1) << (3 * i);
+		code |= ((y >> i) & 1) << (3 * i + 1);
+		code |= ((z >> i) & 1) << (3 * i + 2);
+	}
+	return code;
+}
+
+// Function to extract the cell coordinate of one axis from a morton code
+static uint64_t DecodeAxis(uint64_t code, int axis, int depth)
+{
+	uint64_t value = 0;
+	for (int i = 0; i < depth; i++)
+	{
+		value |= ((code >> (3 * i + axis)) & 1) << i;
+	}
+	return value;
+}
+
+// Function to find the cells of one axis containing a coordinate
+// A coordinate lying on an interior cell boundary belongs to both the cells sharing it
+static int FindAxisCells(float coordinate, float rootMin, float cellSize, int cellCount, int cells[2])
+{
+	if (cellSize <= 0.0f)
+	{
+		cells[0] = 0;
+		return 1;
+	}
+	float cellPosition = (coordinate - rootMin) / cellSize;
+	int cell = std::min(std::max((int)floor(cellPosition), 0), cellCount - 1);
+	cells[0] = cell;
+	if (cell > 0 && cellPosition == (float)cell)
+	{
+		cells[1] = cell - 1;
+		return 2;
+	}
+	return 1;
+}
+
+// Function to find the squared distance between two boxes when the second one is shifted by offset
+static float GetBoxDistanceSquared(BoundingBox box, BoundingBox otherBox, Vec3 offset)
+{
+	float dx = std::max(0.0f, std::max(box.minPosition.x - otherBox.maxPosition.x - offset.x, otherBox.minPosition.x + offset.x - box.maxPosition.x));
+	float dy = std::max(0.0f, std::max(box.minPosition.y - otherBox.maxPosition.y - offset.y, otherBox.minPosition.y + offset.y - box.maxPosition.y));
+	float dz = std::max(0.0f, std::max(box.minPosition.z - otherBox.maxPosition.z - offset.z, otherBox.minPosition.z + offset.z - box.maxPosition.z));
+	return dx * dx + dy * dy + dz * dz;
+}
+
+// Function to find the squared distance between two boxes when the second one is placed by the relative transform
+// A rotated box is replaced by the axis aligned box enclosing it, so the result never exceeds the true distance
+static float GetBoxDistanceSquared(BoundingBox box, BoundingBox otherBox, RelativeTransform &relative)
+{
+	if (!relative.isRotated)
+		return GetBoxDistanceSquared(box, otherBox, relative.translation);
+
+	Vec3 otherCenter = relative.Apply((otherBox.minPosition + otherBox.maxPosition) * 0.5);
+	Vec3 otherExtent = (otherBox.maxPosition - otherBox.minPosition) * 0.5;
+	float (&absoluteRotation)[3][3] = relative.absoluteRotation;
+	Vec3 enclosingExtent(absoluteRotation[0][0] * otherExtent.x + absoluteRotation[0][1] * otherExtent.y + absoluteRotation[0][2] * otherExtent.z,
+		absoluteRotation[1][0] * otherExtent.x + absoluteRotation[1][1] * otherExtent.y + absoluteRotation[1][2] * otherExtent.z,
+		absoluteRotation[2][0] * otherExtent.x + absoluteRotation[2][1] * otherExtent.y + absoluteRotation[2][2] * otherExtent.z);
+
+	BoundingBox enclosingBox;
+	enclosingBox.minPosition = otherCenter - enclosingExtent;
+	enclosingBox.maxPosition = otherCenter + enclosingExtent;
+	return GetBoxDistanceSquared(box, enclosingBox, Vec3(0.0f, 0.0f, 0.0f));
+}
+
+// Function to find the squared distance between a box and a point
+static float GetPointDistanceSquared(BoundingBox box, Vec3 point)
+{
+	BoundingBox pointBox;
+	pointBox.minPosition = point;
+	pointBox.maxPosition = point;
+	return GetBoxDistanceSquared(box, pointBox, Vec3(0.0f, 0.0f, 0.0f));
+}
+
+// Function to get the coordinate of one axis of a vector
+static float GetAxis(Vec3 vector, int axis)
+{
+	return axis == 0 ? vector.x : axis == 1 ? vector.y : vector.z;
+}
+
+// Functions to drop the 16 fractional bits of a fixed point value, rounding down or up
+static int64_t FloorFixed(int64_t value)
+{
+	return value >= 0 ? value >> 16 : -((-value + 0xFFFF) >> 16);
+}
+
+static int64_t CeilFixed(int64_t value)
+{
+	return -FloorFixed(-value);
+}
+
+// Largest magnitudes of a fixed point scale and of a term of a bias, so that u * scale plus the bias stays within 63 bits
+// A scale this large maps every step of the other lattice beyond the whole lattice, and so does a bias term this large
+static const int64_t MAX_FIXED_SCALE = (int64_t)1 << 45;
+static const int64_t MAX_FIXED_BIAS_TERM = (int64_t)1 << 60;
+
+// Function to split a float into an integer mantissa of 24 bits and an exponent, exactly
+static void SplitFloat(float value, int64_t &mantissa, int &exponent)
+{
+	int valueExponent;
+	float fraction = frexpf(value, &valueExponent);
+	mantissa = (int64_t)ldexpf(fraction, 24);
+	exponent = valueExponent - 24;
+}
+
+// Function to divide numerator * 2^shift by a positive denominator, both of 24 bits, rounding down or up
+// Quotients above the limit saturate to it
+static int64_t DivideFixed(int64_t numerator, int shift, int64_t denominator, bool isRoundedUp, int64_t limit)
+{
+	// Rounding a negative quotient down is rounding its magnitude up
+	if (numerator < 0)
+		return -DivideFixed(-numerator, shift, denominator, !isRoundedUp, limit);
+	if (numerator == 0)
+		return 0;
+
+	// A denominator of 24 bits shifted this far exceeds any numerator of 24 bits
+	if (shift < -38)
+		return isRoundedUp ? 1 : 0;
+	if (shift < 0)
+	{
+		denominator <<= -shift;
+		shift = 0;
+	}
+
+	// The shift is brought in 32 bits at a time, the remainder stays below the denominator so nothing overflows
+	int64_t quotient = numerator / denominator;
+	int64_t remainder = numerator % denominator;
+	while (shift > 0)
+	{
+		int step = std::min(shift, 32);
+		if (quotient > (limit >> step))
+			return limit;
+		quotient = (quotient << step) + (remainder << step) / denominator;
+		remainder = (remainder << step) % denominator;
+		shift -= step;
+	}
+	if (isRoundedUp && remainder != 0)
+		quotient++;
+	return std::min(quotient, limit);
+}
+
+// Mapped coordinates are clamped to this magnitude so that they fit the 32 bit lanes, far beyond the 16 bit lattice
+static const int64_t MAPPED_LATTICE_LIMIT = (int64_t)1 << 30;
+
+// Function to check whether two boxes on the lattice overlap after mapping the second one onto the lattice of the first
+// The other box is mapped once and the six compares are done together in 32 bit lanes
+static bool QuantizedOverlaps(QuantizedBox &box, QuantizedBox &otherBox, QuantizedTransform &transform)
+{
+	if (box.minPosition[0] > box.maxPosition[0] || otherBox.minPosition[0] > otherBox.maxPosition[0])
+		return false;
+
+	int32_t otherMin[4] = { 0, 0, 0, 0 };
+	int32_t otherMax[4] = { 0, 0, 0, 0 };
+	for (int axis = 0; axis < 3; axis++)
+	{
+		int64_t mappedMin = FloorFixed(otherBox.minPosition[axis] * transform.lowScale[axis] + transform.lowBias[axis]);
+		int64_t mappedMax = CeilFixed(otherBox.maxPosition[axis] * transform.highScale[axis] + transform.highBias[axis]);
+		otherMin[axis] = (int32_t)std::min(std::max(mappedMin, -MAPPED_LATTICE_LIMIT), MAPPED_LATTICE_LIMIT);
+		otherMax[axis] = (int32_t)std::min(std::max(mappedMax, -MAPPED_LATTICE_LIMIT), MAPPED_LATTICE_LIMIT);
+	}
+
+	// The boxes are separated if a minimum lies above the maximum of the other box on any axis, the unused lane compares equal
+	__m128i boxMin = _mm_setr_epi32(box.minPosition[0], box.minPosition[1], box.minPosition[2], 0);
+	__m128i boxMax = _mm_setr_epi32(box.maxPosition[0], box.maxPosition[1], box.maxPosition[2], 0);
+	__m128i separated = _mm_or_si128(_mm_cmpgt_epi32(boxMin, _mm_loadu_si128((__m128i*)otherMax)),
+		_mm_cmpgt_epi32(_mm_loadu_si128((__m128i*)otherMin), boxMax));
+	return _mm_movemask_epi8(separated) == 0;
+}
+
+// Morton codes hold 21 bits per axis, and a traversal stack holds at most the 8 children of every depth
+static const int MAX_OCTREE_DEPTH = 21;
+static const int MAX_STACK_SIZE = 8 * (MAX_OCTREE_DEPTH + 1);
+
+// Node waiting on the stack of a neighbor query
+struct NodeEntry
+{
+	int node;
+	float lowerBound;
+};
+
+CollisionShape::CollisionShape(PositionView vertices, Vec3 rootMin, Vec3 rootMax, int octreeDepth)
+{
+	if (octreeDepth > MAX_OCTREE_DEPTH)
+	{
+		throw std::runtime_error("octree depth of the collision shape is too large!");
+	}
+	this->octreeDepth = octreeDepth;
+	this->rootMin = rootMin;
+	isQuantized = false;
+
+	float cellCount = (float)(1 << octreeDepth);
+	cellSize = (rootMax - rootMin) * (1.0 / cellCount);
+
+	Build(vertices);
+}
+
+void CollisionShape::Build(PositionView vertices)
+{
+	nodes.clear();
+	cellMarks.clear();
+	leavesByCell.clear();
+	unusedNodeCount = 0;
+
+	// Find the occupied leaf cells
+	std::vector<uint64_t> cells;
+	cells.reserve(vertices.size());
+	for (size_t i = 0; i < vertices.size(); i++)
+	{
+		MarkCells(vertices[i], cells);
+	}
+	std::sort(cells.begin(), cells.end());
+	cells.erase(std::unique(cells.begin(), cells.end()), cells.end());
+
+	if (cells.empty())
+	{
+		ResizeNodeBounds();
+		boundingSphere.radius = 0.0f;
+		return;
+	}
+
+	std::vector<uint64_t> vertexCells;
+	SortVertices(vertices, vertexCells);
+
+	// Build the summary octree over the sorted cells, a quantized shape puts the cells straight on the lattice
+	nodes.push_back(ShapeNode());
+	nodes[0].parent = -1;
+	nodes[0].code = 0;
+	ResizeNodeBounds();
+	BuildNode(0, cells, 0, cells.size(), 0, vertexCells);
+
+	ComputeBoundingSphere();
+}
+
+// The first cell is the one the vertex is binned in
+int CollisionShape::MarkCells(Vec3 vertex, uint64_t cells[8])
+{
+	int cellCount = 1 << octreeDepth;
+	int xCells[2], yCells[2], zCells[2];
+	int xCount = FindAxisCells(vertex.x, rootMin.x, cellSize.x, cellCount, xCells);
+	int yCount = FindAxisCells(vertex.y, rootMin.y, cellSize.y, cellCount, yCells);
+	int zCount = FindAxisCells(vertex.z, rootMin.z, cellSize.z, cellCount, zCells);
+
+	int count = 0;
+	for (int i = 0; i < xCount; i++)
+		for (int j = 0; j < yCount; j++)
+			for (int k = 0; k < zCount; k++)
+				cells[count++] = EncodeCell(xCells[i], yCells[j], zCells[k], octreeDepth);
+	return count;
+}
+
+void CollisionShape::MarkCells(Vec3 vertex, std::vector<uint64_t> &cells)
+{
+	uint64_t vertexCells[8];
+	int count = MarkCells(vertex, vertexCells);
+	cells.insert(cells.end(), vertexCells, vertexCells + count);
+}
+
+uint64_t CollisionShape::GetVertexCell(Vec3 vertex)
+{
+	int cellCount = 1 << octreeDepth;
+	int xCells[2], yCells[2], zCells[2];
+	FindAxisCells(vertex.x, rootMin.x, cellSize.x, cellCount, xCells);
+	FindAxisCells(vertex.y, rootMin.y, cellSize.y, cellCount, yCells);
+	FindAxisCells(vertex.z, rootMin.z, cellSize.z, cellCount, zCells);
+	return EncodeCell(xCells[0], yCells[0], zCells[0], octreeDepth);
+}
+
+void CollisionShape::SortVertices(PositionView vertices, std::vector<uint64_t> &vertexCells)
+{
+	// Every vertex is kept once, in the first of the cells it marked
+	std::vector<std::pair<uint64_t, int>> order(vertices.size());
+	for (size_t i = 0; i < vertices.size(); i++)
+	{
+		order[i] = std::make_pair(GetVertexCell(vertices[i]), (int)i);
+	}
+	std::sort(order.begin(), order.end());
+
+	this->vertices.resize(vertices.size());
+	vertexSlots.resize(vertices.size());
+	nextVertices.assign(vertices.size(), -1);
+	previousVertices.assign(vertices.size(), -1);
+	vertexCells.resize(vertices.size());
+	for (size_t i = 0; i < order.size(); i++)
+	{
+		vertexCells[i] = order[i].first;
+		this->vertices[i] = vertices[order[i].second];
+		vertexSlots[order[i].second] = i;
+	}
+}
+
+void CollisionShape::BuildNode(int nodeIndex, std::vector<uint64_t> &cells, int begin, int end, int depth,
+	std::vector<uint64_t> &vertexCells)
+{
+	nodes[nodeIndex].depth = depth;
+
+	// Cells below the node share the prefix of their morton code, so their vertices are contiguous
+	int nodeShift = 3 * (octreeDepth - depth);
+	uint64_t prefix = cells[begin] >> nodeShift;
+	auto firstVertex = std::lower_bound(vertexCells.begin(), vertexCells.end(), prefix << nodeShift);
+	auto lastVertex = std::lower_bound(firstVertex, vertexCells.end(), (prefix + 1) << nodeShift);
+	nodes[nodeIndex].code = prefix;
+	nodes[nodeIndex].firstVertex = -1;
+	nodes[nodeIndex].vertexCount = lastVertex - firstVertex;
+
+	// Leaf cells are unique, so a leaf always has a single cell
+	if (depth == octreeDepth)
+	{
+		SetLeafBounds(nodeIndex, cells[begin]);
+		nodes[nodeIndex].firstChild = -1;
+		nodes[nodeIndex].childCount = 0;
+
+		// Link the vertices of the leaf in their sorted order
+		int first = firstVertex - vertexCells.begin();
+		int last = lastVertex - vertexCells.begin();
+		for (int i = first; i < last; i++)
+		{
+			nextVertices[i] = i + 1 < last ? i + 1 : -1;
+			previousVertices[i] = i > first ? i - 1 : -1;
+		}
+		nodes[nodeIndex].firstVertex = first < last ? first : -1;
+		return;
+	}
+
+	// Group the sorted cells by the octant they fall into at the next depth
+	int shift = 3 * (octreeDepth - depth - 1);
+	std::vector<int> childBegins;
+	for (int i = begin; i < end; i++)
+	{
+		if (i == begin || (cells[i] >> shift) != (cells[i - 1] >> shift))
+			childBegins.push_back(i);
+	}
+	childBegins.push_back(end);
+
+	// Children are stored next to each other
+	int childCount = childBegins.size() - 1;
+	int firstChild = nodes.size();
+	nodes.resize(nodes.size() + childCount);
+	ResizeNodeBounds();
+	nodes[nodeIndex].firstChild = firstChild;
+	nodes[nodeIndex].childCount = childCount;
+
+	for (int i = 0; i < childCount; i++)
+	{
+		nodes[firstChild + i].parent = nodeIndex;
+		BuildNode(firstChild + i, cells, childBegins[i], childBegins[i + 1], depth + 1, vertexCells);
+	}
+
+	// Summary bounds are the union of the bounds of the children
+	MergeChildBounds(nodeIndex);
+}
+
+void CollisionShape::ComputeBoundingSphere()
+{
+	BoundingBox bounds = GetNodeBounds(0);
+	boundingSphere.center = (bounds.minPosition + bounds.maxPosition) * 0.5;
+	boundingSphere.radius = 0.0f;
+
+	// Radius reaches the farthest corner of every occupied leaf cell
+	for (size_t i = 0; i < nodes.size(); i++)
+	{
+		if (nodes[i].firstChild != -1)
+			continue;
+		BoundingBox cellBounds = GetNodeBounds(i);
+		Vec3 cellCenter = (cellBounds.minPosition + cellBounds.maxPosition) * 0.5;
+		Vec3 halfDiagonal = (cellBounds.maxPosition - cellBounds.minPosition) * 0.5;
+		float distance = (cellCenter - boundingSphere.center).Magnitude() + halfDiagonal.Magnitude();
+		boundingSphere.radius = std::max(boundingSphere.radius, distance);
+	}
+}
+
+BoundingBox CollisionShape::GetCellBounds(uint64_t cell)
+{
+	BoundingBox bounds;
+	bounds.minPosition = Vec3(rootMin.x + DecodeAxis(cell, 0, octreeDepth) * cellSize.x,
+		rootMin.y + DecodeAxis(cell, 1, octreeDepth) * cellSize.y,
+		rootMin.z + DecodeAxis(cell, 2, octreeDepth) * cellSize.z);
+	bounds.maxPosition = bounds.minPosition + cellSize;
+	return bounds;
+}
+
+void CollisionShape::UpdateVertices(std::vector<Vec3> &newVertices)
+{
+	if (newVertices.size() != vertexSlots.size())
+	{
+		throw std::runtime_error("vertex count of the collision shape update does not match!");
+	}
+	if (nodes.empty())
+		return;
+	if (cellMarks.empty())
+		InitializeOccupancy();
+
+	bool isOccupancyChanged = false;
+	for (size_t i = 0; i < newVertices.size(); i++)
+	{
+		int slot = vertexSlots[i];
+		Vec3 vertex = vertices[slot];
+		Vec3 newVertex = newVertices[i];
+		if (vertex.x == newVertex.x && vertex.y == newVertex.y && vertex.z == newVertex.z)
+			continue;
+		vertices[slot] = newVertex;
+
+		// Vertices moving inside their cells leave the octree untouched
+		uint64_t cells[8], newCells[8];
+		int cellCount = MarkCells(vertex, cells);
+		int newCellCount = MarkCells(newVertex, newCells);
+		if (cellCount == newCellCount && std::equal(cells, cells + cellCount, newCells))
+			continue;
+		isOccupancyChanged = true;
+
+		// Mark the new cells first so that cells shared with the old ones stay occupied
+		for (int j = 0; j < newCellCount; j++)
+		{
+			if (cellMarks[newCells[j]]++ == 0)
+				AddCell(newCells[j]);
+		}
+		if (cells[0] != newCells[0])
+			MoveVertex(slot, leavesByCell[cells[0]], leavesByCell[newCells[0]]);
+		for (int j = 0; j < cellCount; j++)
+		{
+			auto mark = cellMarks.find(cells[j]);
+			if (--mark->second == 0)
+			{
+				cellMarks.erase(mark);
+				RemoveCell(cells[j]);
+			}
+		}
+	}
+	if (!isOccupancyChanged)
+		return;
+
+	// Build again once the nodes left behind by moved children outnumber the used ones
+	if (unusedNodeCount > (int)nodes.size() / 2)
+	{
+		std::vector<Vec3> orderedVertices(vertexSlots.size());
+		for (size_t i = 0; i < vertexSlots.size(); i++)
+		{
+			orderedVertices[i] = vertices[vertexSlots[i]];
+		}
+		Build(orderedVertices);
+		return;
+	}
+
+	// Enclosing the root bounds keeps the sphere conservative without visiting the leaves
+	BoundingBox bounds = GetNodeBounds(0);
+	boundingSphere.center = (bounds.minPosition + bounds.maxPosition) * 0.5;
+	boundingSphere.radius = (float)((bounds.maxPosition - bounds.minPosition) * 0.5).Magnitude();
+}
+
+void CollisionShape::InitializeOccupancy()
+{
+	uint64_t cells[8];
+	for (auto vertex : vertices)
+	{
+		int cellCount = MarkCells(vertex, cells);
+		for (int i = 0; i < cellCount; i++)
+		{
+			cellMarks[cells[i]]++;
+		}
+	}
+
+	for (size_t i = 0; i < nodes.size(); i++)
+	{
+		if (nodes[i].depth == octreeDepth)
+			leavesByCell[nodes[i].code] = i;
+	}
+}
+
+void CollisionShape::AddCell(uint64_t cell)
+{
+	// Leaves of cells that were emptied are kept, so a cell occupied again only needs its bounds back
+	auto leaf = leavesByCell.find(cell);
+	int node = leaf != leavesByCell.end() ? leaf->second : InsertLeaf(cell);
+	SetLeafBounds(node, cell);
+	RefitAncestors(node);
+}
+
+void CollisionShape::RemoveCell(uint64_t cell)
+{
+	int node = leavesByCell[cell];
+	ClearNodeBounds(node);
+	RefitAncestors(node);
+}
+
+int CollisionShape::InsertLeaf(uint64_t cell)
+{
+	int node = 0;
+	for (int depth = 1; depth <= octreeDepth; depth++)
+	{
+		uint64_t code = cell >> (3 * (octreeDepth - depth));
+		int child = -1;
+		for (int i = nodes[node].firstChild; i < nodes[node].firstChild + nodes[node].childCount; i++)
+		{
+			if (nodes[i].code == code)
+				child = i;
+		}
+		node = child != -1 ? child : AddChild(node, code);
+	}
+	leavesByCell[cell] = node;
+	return node;
+}
+
+int CollisionShape::AddChild(int node, uint64_t code)
+{
+	// Children are stored next to each other, so they move to the end of the nodes together with the new child
+	int firstChild = nodes.size();
+	int childCount = nodes[node].childCount;
+	int oldFirstChild = nodes[node].firstChild;
+	for (int i = 0; i < childCount; i++)
+	{
+		ShapeNode child = nodes[oldFirstChild + i];
+		nodes.push_back(child);
+		for (int j = child.firstChild; j < child.firstChild + child.childCount; j++)
+		{
+			nodes[j].parent = firstChild + i;
+		}
+		if (child.depth == octreeDepth)
+			leavesByCell[child.code] = firstChild + i;
+	}
+	unusedNodeCount += childCount;
+
+	ShapeNode child;
+	child.firstChild = -1;
+	child.childCount = 0;
+	child.depth = nodes[node].depth + 1;
+	child.parent = node;
+	child.code = code;
+	child.firstVertex = -1;
+	child.vertexCount = 0;
+	nodes.push_back(child);
+
+	ResizeNodeBounds();
+	for (int i = 0; i < childCount; i++)
+	{
+		if (isQuantized)
+			quantizedBounds[firstChild + i] = quantizedBounds[oldFirstChild + i];
+		else
+			nodeBounds[firstChild + i] = nodeBounds[oldFirstChild + i];
+	}
+	ClearNodeBounds(firstChild + childCount);
+
+	nodes[node].firstChild = firstChild;
+	nodes[node].childCount = childCount + 1;
+	return firstChild + childCount;
+}
+
+void CollisionShape::RefitAncestors(int node)
+{
+	// Ancestors above an unchanged node are unchanged too
+	for (int parent = nodes[node].parent; parent != -1; parent = nodes[parent].parent)
+	{
+		if (!MergeChildBounds(parent))
+			break;
+	}
+}
+
+void CollisionShape::ResizeNodeBounds()
+{
+	if (isQuantized)
+		quantizedBounds.resize(nodes.size());
+	else
+		nodeBounds.resize(nodes.size());
+}
+
+BoundingBox CollisionShape::GetNodeBounds(int node)
+{
+	if (!isQuantized)
+		return nodeBounds[node];
+
+	QuantizedBox &box = quantizedBounds[node];
+	if (box.minPosition[0] > box.maxPosition[0])
+		return BoundingBox::Empty();
+	BoundingBox bounds;
+	bounds.minPosition = Vec3(rootMin.x + box.minPosition[0] * latticeStep.x, rootMin.y + box.minPosition[1] * latticeStep.y,
+		rootMin.z + box.minPosition[2] * latticeStep.z);
+	bounds.maxPosition = Vec3(rootMin.x + box.maxPosition[0] * latticeStep.x, rootMin.y + box.maxPosition[1] * latticeStep.y,
+		rootMin.z + box.maxPosition[2] * latticeStep.z);
+	return bounds;
+}
+
+bool CollisionShape::IsNodeEmpty(int node)
+{
+	if (isQuantized)
+		return quantizedBounds[node].minPosition[0] > quantizedBounds[node].maxPosition[0];
+	return nodeBounds[node].minPosition.x > nodeBounds[node].maxPosition.x;
+}
+
+void CollisionShape::SetLeafBounds(int node, uint64_t cell)
+{
+	if (isQuantized)
+		quantizedBounds[node] = QuantizeCell(cell);
+	else
+		nodeBounds[node] = GetCellBounds(cell);
+}
+
+// Empty quantized bounds have the largest minimum and the smallest maximum, so they drop out of a merge like empty float bounds
+void CollisionShape::ClearNodeBounds(int node)
+{
+	if (isQuantized)
+	{
+		for (int axis = 0; axis < 3; axis++)
+		{
+			quantizedBounds[node].minPosition[axis] = UINT16_MAX;
+			quantizedBounds[node].maxPosition[axis] = 0;
+		}
+	}
+	else
+	{
+		nodeBounds[node] = BoundingBox::Empty();
+	}
+}
+
+bool CollisionShape::MergeChildBounds(int node)
+{
+	int firstChild = nodes[node].firstChild;
+	int lastChild = firstChild + nodes[node].childCount;
+	if (isQuantized)
+	{
+		QuantizedBox bounds;
+		for (int axis = 0; axis < 3; axis++)
+		{
+			bounds.minPosition[axis] = UINT16_MAX;
+			bounds.maxPosition[axis] = 0;
+			for (int i = firstChild; i < lastChild; i++)
+			{
+				bounds.minPosition[axis] = std::min(bounds.minPosition[axis], quantizedBounds[i].minPosition[axis]);
+				bounds.maxPosition[axis] = std::max(bounds.maxPosition[axis], quantizedBounds[i].maxPosition[axis]);
+			}
+		}
+		QuantizedBox &oldBounds = quantizedBounds[node];
+		bool isChanged = !std::equal(bounds.minPosition, bounds.minPosition + 3, oldBounds.minPosition) ||
+			!std::equal(bounds.maxPosition, bounds.maxPosition + 3, oldBounds.maxPosition);
+		oldBounds = bounds;
+		return isChanged;
+	}
+
+	BoundingBox bounds = BoundingBox::Empty();
+	for (int i = firstChild; i < lastChild; i++)
+	{
+		bounds = BoundingBox::Merge(bounds, nodeBounds[i]);
+	}
+	BoundingBox &oldBounds = nodeBounds[node];
+	bool isChanged = bounds.minPosition.x != oldBounds.minPosition.x || bounds.minPosition.y != oldBounds.minPosition.y ||
+		bounds.minPosition.z != oldBounds.minPosition.z || bounds.maxPosition.x != oldBounds.maxPosition.x ||
+		bounds.maxPosition.y != oldBounds.maxPosition.y || bounds.maxPosition.z != oldBounds.maxPosition.z;
+	oldBounds = bounds;
+	return isChanged;
+}
+
+void CollisionShape::FitNodeBounds(int node, std::vector<uint8_t> &occupiedLeaves)
+{
+	if (nodes[node].firstChild == -1)
+	{
+		if (occupiedLeaves[node])
+			SetLeafBounds(node, nodes[node].code);
+		else
+			ClearNodeBounds(node);
+		return;
+	}
+
+	for (int i = nodes[node].firstChild; i < nodes[node].firstChild + nodes[node].childCount; i++)
+	{
+		FitNodeBounds(i, occupiedLeaves);
+	}
+	MergeChildBounds(node);
+}
+
+void CollisionShape::MoveVertex(int slot, int leaf, int otherLeaf)
+{
+	// Unlink the vertex from its leaf
+	int next = nextVertices[slot];
+	int previous = previousVertices[slot];
+	if (previous != -1)
+		nextVertices[previous] = next;
+	else
+		nodes[leaf].firstVertex = next;
+	if (next != -1)
+		previousVertices[next] = previous;
+
+	// Link it first in the other leaf
+	int first = nodes[otherLeaf].firstVertex;
+	nextVertices[slot] = first;
+	previousVertices[slot] = -1;
+	if (first != -1)
+		previousVertices[first] = slot;
+	nodes[otherLeaf].firstVertex = slot;
+
+	for (int node = leaf; node != -1; node = nodes[node].parent)
+	{
+		nodes[node].vertexCount--;
+	}
+	for (int node = otherLeaf; node != -1; node = nodes[node].parent)
+	{
+		nodes[node].vertexCount++;
+	}
+}
+
+bool BoundingBox::Overlaps(BoundingBox box, BoundingBox otherBox, RelativeTransform &relative)
+{
+	if (!relative.isRotated)
+		return Overlaps(box, otherBox, relative.translation);
+
+	// Centers and half extents of the boxes, the other center is moved into the frame of the box
+	float extent[3] = { (box.maxPosition.x - box.minPosition.x) * 0.5f,
+		(box.maxPosition.y - box.minPosition.y) * 0.5f, (box.maxPosition.z - box.minPosition.z) * 0.5f };
+	float otherExtent[3] = { (otherBox.maxPosition.x - otherBox.minPosition.x) * 0.5f,
+		(otherBox.maxPosition.y - otherBox.minPosition.y) * 0.5f, (otherBox.maxPosition.z - otherBox.minPosition.z) * 0.5f };
+	Vec3 center = (box.minPosition + box.maxPosition) * 0.5;
+	Vec3 otherCenter = relative.Apply((otherBox.minPosition + otherBox.maxPosition) * 0.5);
+	float distance[3] = { otherCenter.x - center.x, otherCenter.y - center.y, otherCenter.z - center.z };
+
+	float (&rotation)[3][3] = relative.rotation;
+	float (&absoluteRotation)[3][3] = relative.absoluteRotation;
+
+	// The gap along every axis is computed without branches so that the axes are vectorized,
+	// the boxes are separated if any gap is positive
+	float gaps[15];
+	for (int i = 0; i < 3; i++)
+	{
+		gaps[i] = fabsf(distance[i]) - extent[i] -
+			(otherExtent[0] * absoluteRotation[i][0] + otherExtent[1] * absoluteRotation[i][1] + otherExtent[2] * absoluteRotation[i][2]);
+	}
+	for (int j = 0; j < 3; j++)
+	{
+		gaps[3 + j] = fabsf(distance[0] * rotation[0][j] + distance[1] * rotation[1][j] + distance[2] * rotation[2][j]) -
+			(extent[0] * absoluteRotation[0][j] + extent[1] * absoluteRotation[1][j] + extent[2] * absoluteRotation[2][j]) -
+			otherExtent[j];
+	}
+	for (int i = 0; i < 3; i++)
+	{
+		int i1 = (i + 1) % 3;
+		int i2 = (i + 2) % 3;
+		for (int j = 0; j < 3; j++)
+		{
+			int j1 = (j + 1) % 3;
+			int j2 = (j + 2) % 3;
+			gaps[6 + 3 * i + j] = fabsf(distance[i2] * rotation[i1][j] - distance[i1] * rotation[i2][j]) -
+				(extent[i1] * absoluteRotation[i2][j] + extent[i2] * absoluteRotation[i1][j]) -
+				(otherExtent[j1] * absoluteRotation[i][j2] + otherExtent[j2] * absoluteRotation[i][j1]);
+		}
+	}
+
+	bool isSeparated = false;
+	for (int axis = 0; axis < 15; axis++)
+	{
+		isSeparated |= gaps[axis] > 0.0f;
+	}
+	return !isSeparated;
+}
+
+CollisionResult CollisionShape::CheckNodes(int node, CollisionShape *otherShape, int otherNode, RelativeTransform &relative,
+	QuantizedTransform *quantized, int maxDepth)
+{
+	ShapeNode &current = nodes[node];
+	ShapeNode &other = otherShape->nodes[otherNode];
+
+	bool isOverlapping = quantized != nullptr ?
+		QuantizedOverlaps(quantizedBounds[node], otherShape->quantizedBounds[otherNode], *quantized) :
+		BoundingBox::Overlaps(GetNodeBounds(node), otherShape->GetNodeBounds(otherNode), relative);
+	if (!isOverlapping)
+		return COLLISION_NONE;
+
+	bool isCurrentLeaf = current.firstChild == -1;
+	bool isOtherLeaf = other.firstChild == -1;
+	bool isCurrentFinal = isCurrentLeaf || current.depth >= maxDepth;
+	bool isOtherFinal = isOtherLeaf || other.depth >= maxDepth;
+	if (isCurrentFinal && isOtherFinal)
+		return isCurrentLeaf && isOtherLeaf ? COLLISION_CONFIRMED : COLLISION_POSSIBLE;
+
+	// Keep looking for a confirmed collision after a possible one
+	CollisionResult result = COLLISION_NONE;
+
+	// Descend the shallower node first so that both sides are refined evenly
+	if (!isCurrentFinal && (isOtherFinal || current.depth <= other.depth))
+	{
+		for (int i = 0; i < current.childCount; i++)
+		{
+			CollisionResult childResult = CheckNodes(current.firstChild + i, otherShape, otherNode, relative, quantized, maxDepth);
+			if (childResult == COLLISION_CONFIRMED)
+				return COLLISION_CONFIRMED;
+			if (childResult == COLLISION_POSSIBLE)
+				result = COLLISION_POSSIBLE;
+		}
+		return result;
+	}
+
+	for (int i = 0; i < other.childCount; i++)
+	{
+		CollisionResult childResult = CheckNodes(node, otherShape, other.firstChild + i, relative, quantized, maxDepth);
+		if (childResult == COLLISION_CONFIRMED)
+			return COLLISION_CONFIRMED;
+		if (childResult == COLLISION_POSSIBLE)
+			result = COLLISION_POSSIBLE;
+	}
+	return result;
+}
+
+// Function to set a bit for every lane of a block whose offset places the other box over the box on all axes
+// The lanes are compared four at a time in the same order of operations as BoundingBox::Overlaps
+static uint64_t GetLanesInRange(PoseBatch &poses, size_t word, BoundingBox box, BoundingBox otherBox)
+{
+	__m128 minimum[3] = { _mm_set1_ps(box.minPosition.x), _mm_set1_ps(box.minPosition.y), _mm_set1_ps(box.minPosition.z) };
+	__m128 maximum[3] = { _mm_set1_ps(box.maxPosition.x), _mm_set1_ps(box.maxPosition.y), _mm_set1_ps(box.maxPosition.z) };
+	__m128 otherMinimum[3] = { _mm_set1_ps(otherBox.minPosition.x), _mm_set1_ps(otherBox.minPosition.y),
+		_mm_set1_ps(otherBox.minPosition.z) };
+	__m128 otherMaximum[3] = { _mm_set1_ps(otherBox.maxPosition.x), _mm_set1_ps(otherBox.maxPosition.y),
+		_mm_set1_ps(otherBox.maxPosition.z) };
+
+	uint64_t bits = 0;
+	for (int lane = 0; lane < 64; lane += 4)
+	{
+		__m128 inRange = _mm_castsi128_ps(_mm_set1_epi32(-1));
+		for (int axis = 0; axis < 3; axis++)
+		{
+			__m128 offset = _mm_loadu_ps(&poses.translation[axis][word * 64 + lane]);
+			inRange = _mm_and_ps(inRange, _mm_cmple_ps(minimum[axis], _mm_add_ps(otherMaximum[axis], offset)));
+			inRange = _mm_and_ps(inRange, _mm_cmple_ps(_mm_add_ps(otherMinimum[axis], offset), maximum[axis]));
+		}
+		bits |= (uint64_t)_mm_movemask_ps(inRange) << lane;
+	}
+	return bits;
+}
+
+// Function to set a bit for every lane of a block whose relative transform places the other box over the box
+// The lanes are tested four at a time on the 15 separating axes in the same order of operations as BoundingBox::Overlaps
+static uint64_t GetLanesOverlapping(PoseBatch &poses, size_t word, BoundingBox box, BoundingBox otherBox)
+{
+	Vec3 center = (box.minPosition + box.maxPosition) * 0.5;
+	Vec3 otherCenter = (otherBox.minPosition + otherBox.maxPosition) * 0.5;
+	__m128 extent[3] = { _mm_set1_ps((box.maxPosition.x - box.minPosition.x) * 0.5f),
+		_mm_set1_ps((box.maxPosition.y - box.minPosition.y) * 0.5f), _mm_set1_ps((box.maxPosition.z - box.minPosition.z) * 0.5f) };
+	__m128 otherExtent[3] = { _mm_set1_ps((otherBox.maxPosition.x - otherBox.minPosition.x) * 0.5f),
+		_mm_set1_ps((otherBox.maxPosition.y - otherBox.minPosition.y) * 0.5f),
+		_mm_set1_ps((otherBox.maxPosition.z - otherBox.minPosition.z) * 0.5f) };
+	__m128 centers[3] = { _mm_set1_ps(center.x), _mm_set1_ps(center.y), _mm_set1_ps(center.z) };
+	__m128 otherCenters[3] = { _mm_set1_ps(otherCenter.x), _mm_set1_ps(otherCenter.y), _mm_set1_ps(otherCenter.z) };
+	__m128 absoluteMask = _mm_castsi128_ps(_mm_set1_epi32(0x7FFFFFFF));
+	__m128 zero = _mm_setzero_ps();
+
+	uint64_t separatedBits = 0;
+	for (int lane = 0; lane < 64; lane += 4)
+	{
+		size_t index = word * 64 + lane;
+		__m128 rotation[3][3];
+		__m128 absoluteRotation[3][3];
+		for (int i = 0; i < 3; i++)
+		{
+			for (int j = 0; j < 3; j++)
+			{
+				rotation[i][j] = _mm_loadu_ps(&poses.rotation[3 * i + j][index]);
+				absoluteRotation[i][j] = _mm_loadu_ps(&poses.absoluteRotation[3 * i + j][index]);
+			}
+		}
+
+		// Distance between the centers in the frame of the box
+		__m128 distance[3];
+		for (int i = 0; i < 3; i++)
+		{
+			__m128 rotated = _mm_add_ps(_mm_add_ps(_mm_mul_ps(rotation[i][0], otherCenters[0]), _mm_mul_ps(rotation[i][1], otherCenters[1])),
+				_mm_mul_ps(rotation[i][2], otherCenters[2]));
+			distance[i] = _mm_sub_ps(_mm_add_ps(rotated, _mm_loadu_ps(&poses.translation[i][index])), centers[i]);
+		}
+
+		// The boxes are separated if the gap along any axis is positive
+		__m128 isSeparated = zero;
+		for (int i = 0; i < 3; i++)
+		{
+			__m128 radius = _mm_add_ps(_mm_add_ps(_mm_mul_ps(otherExtent[0], absoluteRotation[i][0]),
+				_mm_mul_ps(otherExtent[1], absoluteRotation[i][1])), _mm_mul_ps(otherExtent[2], absoluteRotation[i][2]));
+			__m128 gap = _mm_sub_ps(_mm_sub_ps(_mm_and_ps(distance[i], absoluteMask), extent[i]), radius);
+			isSeparated = _mm_or_ps(isSeparated, _mm_cmpgt_ps(gap, zero));
+		}
+		for (int j = 0; j < 3; j++)
+		{
+			__m128 projected = _mm_add_ps(_mm_add_ps(_mm_mul_ps(distance[0], rotation[0][j]), _mm_mul_ps(distance[1], rotation[1][j])),
+				_mm_mul_ps(distance[2], rotation[2][j]));
+			__m128 radius = _mm_add_ps(_mm_add_ps(_mm_mul_ps(extent[0], absoluteRotation[0][j]), _mm_mul_ps(extent[1], absoluteRotation[1][j])),
+				_mm_mul_ps(extent[2], absoluteRotation[2][j]));
+			__m128 gap = _mm_sub_ps(_mm_sub_ps(_mm_and_ps(projected, absoluteMask), radius), otherExtent[j]);
+			isSeparated = _mm_or_ps(isSeparated, _mm_cmpgt_ps(gap, zero));
+		}
+		for (int i = 0; i < 3; i++)
+		{
+			int i1 = (i + 1) % 3;
+			int i2 = (i + 2) % 3;
+			for (int j = 0; j < 3; j++)
+			{
+				int j1 = (j + 1) % 3;
+				int j2 = (j + 2) % 3;
+				__m128 projected = _mm_sub_ps(_mm_mul_ps(distance[i2], rotation[i1][j]), _mm_mul_ps(distance[i1], rotation[i2][j]));
+				__m128 radius = _mm_add_ps(_mm_mul_ps(extent[i1], absoluteRotation[i2][j]), _mm_mul_ps(extent[i2], absoluteRotation[i1][j]));
+				__m128 otherRadius = _mm_add_ps(_mm_mul_ps(otherExtent[j1], absoluteRotation[i][j2]),
+					_mm_mul_ps(otherExtent[j2], absoluteRotation[i][j1]));
+				__m128 gap = _mm_sub_ps(_mm_sub_ps(_mm_and_ps(projected, absoluteMask), radius), otherRadius);
+				isSeparated = _mm_or_ps(isSeparated, _mm_cmpgt_ps(gap, zero));
+			}
+		}
+		separatedBits |= (uint64_t)_mm_movemask_ps(isSeparated) << lane;
+	}
+	return ~separatedBits;
+}
+
+void CollisionShape::CheckNodesBatch(int node, CollisionShape *otherShape, int otherNode, PoseBatch &poses,
+	std::vector<std::vector<uint64_t>> &masks, int level, std::vector<uint64_t> &results)
+{
+	ShapeNode &current = nodes[node];
+	ShapeNode &other = otherShape->nodes[otherNode];
+	BoundingBox bounds = GetNodeBounds(node);
+	BoundingBox otherBounds = otherShape->GetNodeBounds(otherNode);
+
+	// Poses already resolved as colliding are dropped
+	// Each block only runs the tests its live lanes need, and the rotated lanes take the separating axis result
+	std::vector<uint64_t> &liveMask = masks[level];
+	std::vector<uint64_t> &mask = masks[level + 1];
+	bool isAnyLive = false;
+	for (size_t word = 0; word < poses.wordCount; word++)
+	{
+		uint64_t live = liveMask[word] & ~results[word];
+		uint64_t rotated = poses.rotatedMask[word];
+		uint64_t overlapping = 0;
+		if ((live & ~rotated) != 0)
+			overlapping |= GetLanesInRange(poses, word, bounds, otherBounds) & ~rotated;
+		if ((live & rotated) != 0)
+			overlapping |= GetLanesOverlapping(poses, word, bounds, otherBounds) & rotated;
+		mask[word] = live & overlapping;
+		isAnyLive |= mask[word] != 0;
+	}
+	if (!isAnyLive)
+		return;
+
+	bool isCurrentLeaf = current.firstChild == -1;
+	bool isOtherLeaf = other.firstChild == -1;
+	if (isCurrentLeaf && isOtherLeaf)
+	{
+		for (size_t word = 0; word < poses.wordCount; word++)
+		{
+			results[word] |= mask[word];
+		}
+		return;
+	}
+
+	// Descend the shallower node first so that both sides are refined evenly
+	if (!isCurrentLeaf && (isOtherLeaf || current.depth <= other.depth))
+	{
+		for (int i = 0; i < current.childCount; i++)
+		{
+			CheckNodesBatch(current.firstChild + i, otherShape, otherNode, poses, masks, level + 1, results);
+		}
+		return;
+	}
+
+	for (int i = 0; i < other.childCount; i++)
+	{
+		CheckNodesBatch(node, otherShape, other.firstChild + i, poses, masks, level + 1, results);
+	}
+}
+
+void CollisionShape::CheckPosesBatch(CollisionShape *otherShape, PoseBatch &poses, size_t poseCount, std::vector<uint64_t> &results)
+{
+	// Reject poses on the bounding spheres first
+	std::vector<std::vector<uint64_t>> masks(octreeDepth + otherShape->octreeDepth + 3,
+		std::vector<uint64_t>(poses.wordCount, 0));
+	Vec3 otherCenter = otherShape->boundingSphere.center;
+	float radiusSum = boundingSphere.radius + otherShape->boundingSphere.radius;
+	for (size_t i = 0; i < poseCount; i++)
+	{
+		Vec3 center = otherCenter + Vec3(poses.translation[0][i], poses.translation[1][i], poses.translation[2][i]);
+		if ((poses.rotatedMask[i / 64] >> (i % 64)) & 1)
+		{
+			center = Vec3(poses.rotation[0][i] * otherCenter.x + poses.rotation[1][i] * otherCenter.y + poses.rotation[2][i] * otherCenter.z +
+				poses.translation[0][i],
+				poses.rotation[3][i] * otherCenter.x + poses.rotation[4][i] * otherCenter.y + poses.rotation[5][i] * otherCenter.z +
+				poses.translation[1][i],
+				poses.rotation[6][i] * otherCenter.x + poses.rotation[7][i] * otherCenter.y + poses.rotation[8][i] * otherCenter.z +
+				poses.translation[2][i]);
+		}
+		Vec3 centerDistance = center - boundingSphere.center;
+		if (centerDistance * centerDistance <= radiusSum * radiusSum)
+			masks[0][i / 64] |= (uint64_t)1 << (i % 64);
+	}
+
+	CheckNodesBatch(0, otherShape, 0, poses, masks, 0, results);
+}
+
+void CollisionShape::CheckCollisionBatch(CollisionShape *otherShape, Vec3 position, std::vector<Vec3> &otherPositions,
+	std::vector<uint64_t> &results)
+{
+	size_t wordCount = (otherPositions.size() + 63) / 64;
+	results.assign(wordCount, 0);
+	if (nodes.empty() || otherShape->nodes.empty() || wordCount == 0)
+		return;
+
+	// Lay out the offsets per axis, padding lanes are pushed far away so that they never collide
+	PoseBatch poses;
+	poses.wordCount = wordCount;
+	poses.rotatedMask.assign(wordCount, 0);
+	for (int axis = 0; axis < 3; axis++)
+	{
+		poses.translation[axis].assign(wordCount * 64, FLT_MAX);
+	}
+	for (size_t i = 0; i < otherPositions.size(); i++)
+	{
+		poses.translation[0][i] = otherPositions[i].x - position.x;
+		poses.translation[1][i] = otherPositions[i].y - position.y;
+		poses.translation[2][i] = otherPositions[i].z - position.z;
+	}
+
+	CheckPosesBatch(otherShape, poses, otherPositions.size(), results);
+}
+
+void CollisionShape::CheckCollisionBatch(CollisionShape *otherShape, CollisionTransform transform, std::vector<CollisionTransform> &otherTransforms,
+	std::vector<uint64_t> &results)
+{
+	size_t wordCount = (otherTransforms.size() + 63) / 64;
+	results.assign(wordCount, 0);
+	if (nodes.empty() || otherShape->nodes.empty() || wordCount == 0)
+		return;
+
+	// Every pose is moved into the frame of this shape, padding lanes are pushed far away so that they never collide
+	std::vector<RelativeTransform> relatives(otherTransforms.size());
+	PoseBatch poses;
+	poses.wordCount = wordCount;
+	poses.rotatedMask.assign(wordCount, 0);
+	for (size_t i = 0; i < otherTransforms.size(); i++)
+	{
+		relatives[i] = RelativeTransform::Create(transform, otherTransforms[i]);
+		if (relatives[i].isRotated)
+			poses.rotatedMask[i / 64] |= (uint64_t)1 << (i % 64);
+	}
+	bool isAnyRotated = std::any_of(poses.rotatedMask.begin(), poses.rotatedMask.end(), [](uint64_t bits) { return bits != 0; });
+
+	for (int axis = 0; axis < 3; axis++)
+	{
+		poses.translation[axis].assign(wordCount * 64, FLT_MAX);
+	}
+	for (int element = 0; isAnyRotated && element < 9; element++)
+	{
+		poses.rotation[element].assign(wordCount * 64, 0.0f);
+		poses.absoluteRotation[element].assign(wordCount * 64, 0.0f);
+	}
+	for (size_t i = 0; i < relatives.size(); i++)
+	{
+		poses.translation[0][i] = relatives[i].translation.x;
+		poses.translation[1][i] = relatives[i].translation.y;
+		poses.translation[2][i] = relatives[i].translation.z;
+		for (int element = 0; isAnyRotated && element < 9; element++)
+		{
+			poses.rotation[element][i] = relatives[i].rotation[element / 3][element % 3];
+			poses.absoluteRotation[element][i] = relatives[i].absoluteRotation[element / 3][element % 3];
+		}
+	}
+
+	CheckPosesBatch(otherShape, poses, otherTransforms.size(), results);
+}
+
+float CollisionShape::GetLeafDistanceSquared(int node, CollisionShape *otherShape, int otherNode, RelativeTransform &relative)
+{
+	ShapeNode &current = nodes[node];
+	ShapeNode &other = otherShape->nodes[otherNode];
+
+	// Every vertex of the other leaf is moved into the frame of this shape once
+	float bestDistance = FLT_MAX;
+	for (int j = other.firstVertex; j != -1; j = otherShape->nextVertices[j])
+	{
+		Vec3 otherVertex = relative.Apply(otherShape->vertices[j]);
+		for (int i = current.firstVertex; i != -1; i = nextVertices[i])
+		{
+			Vec3 vertex = vertices[i];
+			float dx = otherVertex.x - vertex.x;
+			float dy = otherVertex.y - vertex.y;
+			float dz = otherVertex.z - vertex.z;
+			bestDistance = std::min(bestDistance, dx * dx + dy * dy + dz * dz);
+		}
+	}
+	return bestDistance;
+}
+
+float CollisionShape::FindDistanceSquared(CollisionShape *otherShape, RelativeTransform &relative, float maxDistance, float stopDistance)
+{
+	float bestDistance = maxDistance * maxDistance;
+	float stopDistanceSquared = stopDistance * stopDistance;
+
+	std::priority_queue<NodePair, std::vector<NodePair>, std::greater<NodePair>> queue;
+	queue.push({ GetBoxDistanceSquared(GetNodeBounds(0), otherShape->GetNodeBounds(0), relative), 0, 0 });
+	while (!queue.empty())
+	{
+		NodePair pair = queue.top();
+		queue.pop();
+
+		// Every remaining pair is at least as far as this one
+		if (pair.lowerBound >= bestDistance)
+			break;
+
+		ShapeNode &current = nodes[pair.node];
+		ShapeNode &other = otherShape->nodes[pair.otherNode];
+		bool isCurrentLeaf = current.firstChild == -1;
+		bool isOtherLeaf = other.firstChild == -1;
+		if (isCurrentLeaf && isOtherLeaf)
+		{
+			bestDistance = std::min(bestDistance, GetLeafDistanceSquared(pair.node, otherShape, pair.otherNode, relative));
+			if (bestDistance < stopDistanceSquared)
+				break;
+			continue;
+		}
+
+		// Split the shallower node, nodes without vertices only come from boundary cells and are skipped
+		if (!isCurrentLeaf && (isOtherLeaf || current.depth <= other.depth))
+		{
+			BoundingBox otherBounds = otherShape->GetNodeBounds(pair.otherNode);
+			for (int i = current.firstChild; i < current.firstChild + current.childCount; i++)
+			{
+				if (nodes[i].vertexCount == 0)
+					continue;
+				float lowerBound = GetBoxDistanceSquared(GetNodeBounds(i), otherBounds, relative);
+				if (lowerBound < bestDistance)
+					queue.push({ lowerBound, i, pair.otherNode });
+			}
+			continue;
+		}
+
+		BoundingBox bounds = GetNodeBounds(pair.node);
+		for (int i = other.firstChild; i < other.firstChild + other.childCount; i++)
+		{
+			if (otherShape->nodes[i].vertexCount == 0)
+				continue;
+			float lowerBound = GetBoxDistanceSquared(bounds, otherShape->GetNodeBounds(i), relative);
+			if (lowerBound < bestDistance)
+				queue.push({ lowerBound, pair.node, i });
+		}
+	}
+	return bestDistance;
+}
+
+float CollisionShape::Distance(CollisionShape *otherShape, Vec3 position, Vec3 otherPosition, float maxDistance)
+{
+	CollisionTransform transform = { position, CollisionRotation::Identity() };
+	CollisionTransform otherTransform = { otherPosition, CollisionRotation::Identity() };
+	return Distance(otherShape, transform, otherTransform, maxDistance);
+}
+
+float CollisionShape::Distance(CollisionShape *otherShape, CollisionTransform transform, CollisionTransform otherTransform,
+	float maxDistance)
+{
+	if (nodes.empty() || otherShape->nodes.empty())
+		return maxDistance;
+
+	// Distances do not change under a rigid transform, so the search runs in the frame of this shape
+	RelativeTransform relative = RelativeTransform::Create(transform, otherTransform);
+
+	// The spheres give a lower bound before any node is visited
+	BoundingSphere otherSphere = otherShape->boundingSphere;
+	Vec3 centerDistance = relative.Apply(otherSphere.center) - boundingSphere.center;
+	float sphereDistance = (float)centerDistance.Magnitude() - boundingSphere.radius - otherSphere.radius;
+	if (sphereDistance >= maxDistance)
+		return maxDistance;
+
+	return std::min(maxDistance, sqrtf(FindDistanceSquared(otherShape, relative, maxDistance, 0.0f)));
+}
+
+bool CollisionShape::IsWithinDistance(CollisionShape *otherShape, Vec3 position, Vec3 otherPosition, float distance)
+{
+	CollisionTransform transform = { position, CollisionRotation::Identity() };
+	CollisionTransform otherTransform = { otherPosition, CollisionRotation::Identity() };
+	return IsWithinDistance(otherShape, transform, otherTransform, distance);
+}
+
+bool CollisionShape::IsWithinDistance(CollisionShape *otherShape, CollisionTransform transform, CollisionTransform otherTransform,
+	float distance)
+{
+	if (nodes.empty() || otherShape->nodes.empty())
+		return false;
+
+	RelativeTransform relative = RelativeTransform::Create(transform, otherTransform);
+	return FindDistanceSquared(otherShape, relative, distance, distance) < distance * distance;
+}
+
+Vec3 CollisionShape::ClosestPoint(Vec3 point, Vec3 position)
+{
+	if (nodes.empty())
+		return position;
+
+	Vec3 localPoint = point - position;
+	float bestDistance = FLT_MAX;
+	int bestVertex = 0;
+
+	std::priority_queue<NodePair, std::vector<NodePair>, std::greater<NodePair>> queue;
+	queue.push({ GetPointDistanceSquared(GetNodeBounds(0), localPoint), 0, 0 });
+	while (!queue.empty())
+	{
+		NodePair pair = queue.top();
+		queue.pop();
+		if (pair.lowerBound >= bestDistance)
+			break;
+
+		ShapeNode &current = nodes[pair.node];
+		if (current.firstChild == -1)
+		{
+			for (int i = current.firstVertex; i != -1; i = nextVertices[i])
+			{
+				Vec3 difference = vertices[i] - localPoint;
+				float distance = (float)(difference * difference);
+				if (distance < bestDistance)
+				{
+					bestDistance = distance;
+					bestVertex = i;
+				}
+			}
+			continue;
+		}
+
+		for (int i = current.firstChild; i < current.firstChild + current.childCount; i++)
+		{
+			if (nodes[i].vertexCount == 0)
+				continue;
+			float lowerBound = GetPointDistanceSquared(GetNodeBounds(i), localPoint);
+			if (lowerBound < bestDistance)
+				queue.push({ lowerBound, i, 0 });
+		}
+	}
+	return vertices[bestVertex] + position;
+}
+
+void CollisionShape::FindNearest(Vec3 localPoint, int k, VertexNeighbor *results, int &count)
+{
+	count = 0;
+
+	// Depth first with the closest child on top, the stack lives on the call stack
+	NodeEntry stack[MAX_STACK_SIZE];
+	int stackSize = 0;
+	stack[stackSize++] = { 0, GetPointDistanceSquared(GetNodeBounds(0), localPoint) };
+	while (stackSize > 0)
+	{
+		NodeEntry entry = stack[--stackSize];
+
+		// The farthest kept vertex bounds the search once k vertices are found
+		if (count == k && entry.lowerBound >= results[0].distanceSquared)
+			continue;
+
+		ShapeNode &current = nodes[entry.node];
+		if (current.firstChild == -1)
+		{
+			for (int i = current.firstVertex; i != -1; i = nextVertices[i])
+			{
+				Vec3 difference = vertices[i] - localPoint;
+				float distance = (float)(difference * difference);
+				if (count < k)
+				{
+					results[count++] = { vertices[i], distance };
+					std::push_heap(results, results + count);
+				}
+				else if (distance < results[0].distanceSquared)
+				{
+					std::pop_heap(results, results + count);
+					results[count - 1] = { vertices[i], distance };
+					std::push_heap(results, results + count);
+				}
+			}
+			continue;
+		}
+
+		NodeEntry children[8];
+		int childCount = 0;
+		for (int i = current.firstChild; i < current.firstChild + current.childCount; i++)
+		{
+			if (nodes[i].vertexCount > 0)
+				children[childCount++] = { i, GetPointDistanceSquared(GetNodeBounds(i), localPoint) };
+		}
+		std::sort(children, children + childCount, [](const NodeEntry &a, const NodeEntry &b) { return a.lowerBound > b.lowerBound; });
+		for (int i = 0; i < childCount; i++)
+		{
+			stack[stackSize++] = children[i];
+		}
+	}
+}
+
+void CollisionShape::KNearest(Vec3 point, Vec3 position, int k, std::vector<VertexNeighbor> &results)
+{
+	results.clear();
+	if (nodes.empty() || k <= 0)
+		return;
+
+	Vec3 localPoint = point - position;
+	results.resize(k);
+	int count;
+	FindNearest(localPoint, k, results.data(), count);
+	std::sort_heap(results.begin(), results.begin() + count);
+	results.resize(count);
+
+	for (auto &neighbor : results)
+	{
+		neighbor.vertex = neighbor.vertex + position;
+	}
+}
+
+void CollisionShape::KNearestBatch(std::vector<Vec3> &points, Vec3 position, int k, std::vector<VertexNeighbor> &results)
+{
+	VertexNeighbor empty = { Vec3(0.0f, 0.0f, 0.0f), FLT_MAX };
+	results.assign(points.size() * std::max(k, 0), empty);
+	if (nodes.empty() || k <= 0)
+		return;
+
+	// Visit the points in the order of their cells so that neighboring queries touch the same nodes
+	std::vector<std::pair<uint64_t, int>> order(points.size());
+	for (size_t i = 0; i < points.size(); i++)
+	{
+		order[i] = std::make_pair(GetVertexCell(points[i] - position), (int)i);
+	}
+	std::sort(order.begin(), order.end());
+
+	for (auto &query : order)
+	{
+		VertexNeighbor *queryResults = results.data() + (size_t)query.second * k;
+		int count;
+		FindNearest(points[query.second] - position, k, queryResults, count);
+		std::sort_heap(queryResults, queryResults + count);
+		for (int i = 0; i < count; i++)
+		{
+			queryResults[i].vertex = queryResults[i].vertex + position;
+		}
+	}
+}
+
+void CollisionShape::RadiusSearch(Vec3 point, Vec3 position, float radius, std::vector<VertexNeighbor> &results)
+{
+	results.clear();
+	if (nodes.empty())
+		return;
+
+	Vec3 localPoint = point - position;
+	float radiusSquared = radius * radius;
+
+	NodeEntry stack[MAX_STACK_SIZE];
+	int stackSize = 0;
+	stack[stackSize++] = { 0, GetPointDistanceSquared(GetNodeBounds(0), localPoint) };
+	while (stackSize > 0)
+	{
+		NodeEntry entry = stack[--stackSize];
+		if (entry.lowerBound > radiusSquared)
+			continue;
+
+		ShapeNode &current = nodes[entry.node];
+		if (current.firstChild == -1)
+		{
+			for (int i = current.firstVertex; i != -1; i = nextVertices[i])
+			{
+				Vec3 difference = vertices[i] - localPoint;
+				float distance = (float)(difference * difference);
+				if (distance <= radiusSquared)
+					results.push_back({ vertices[i] + position, distance });
+			}
+			continue;
+		}
+
+		for (int i = current.firstChild; i < current.firstChild + current.childCount; i++)
+		{
+			if (nodes[i].vertexCount > 0)
+				stack[stackSize++] = { i, GetPointDistanceSquared(GetNodeBounds(i), localPoint) };
+		}
+	}
+}
+
+void CollisionShape::SetQuantized(bool isQuantized)
+{
+	if (isQuantized && octreeDepth > QUANTIZED_BITS)
+	{
+		throw std::runtime_error("octree depth of the collision shape is too large to quantize!");
+	}
+	if (isQuantized == this->isQuantized)
+		return;
+
+	// Leaves emptied by vertex updates stay empty in the other representation
+	std::vector<uint8_t> occupiedLeaves(nodes.size());
+	for (size_t i = 0; i < nodes.size(); i++)
+	{
+		occupiedLeaves[i] = !IsNodeEmpty(i);
+	}
+
+	// Only one representation is kept, so the other one is freed
+	this->isQuantized = isQuantized;
+	if (isQuantized)
+	{
+		latticeStep = cellSize * (1.0 / (1 << (QUANTIZED_BITS - octreeDepth)));
+		std::vector<BoundingBox>().swap(nodeBounds);
+	}
+	else
+	{
+		std::vector<QuantizedBox>().swap(quantizedBounds);
+	}
+	ResizeNodeBounds();
+	if (!nodes.empty())
+		FitNodeBounds(0, occupiedLeaves);
+}
+
+bool CollisionShape::IsQuantized()
+{
+	return isQuantized;
+}
+
+// A lattice step divides a leaf cell evenly, so a cell is a whole number of steps and is put on the lattice with integers only
+// A flat axis has no extent, so its cells lie on the lattice origin
+QuantizedBox CollisionShape::QuantizeCell(uint64_t cell)
+{
+	QuantizedBox box;
+	int shift = QUANTIZED_BITS - octreeDepth;
+	for (int axis = 0; axis < 3; axis++)
+	{
+		if (GetAxis(cellSize, axis) <= 0.0f)
+		{
+			box.minPosition[axis] = 0;
+			box.maxPosition[axis] = 0;
+			continue;
+		}
+		uint64_t cellPosition = DecodeAxis(cell, axis, octreeDepth);
+		box.minPosition[axis] = (uint16_t)(cellPosition << shift);
+		box.maxPosition[axis] = (uint16_t)((cellPosition + 1) << shift);
+	}
+	return box;
+}
+
+// The step of a flat axis is taken as one unit, which keeps the map onto it finite
+void CollisionShape::GetLatticeStep(int axis, int64_t &mantissa, int &exponent)
+{
+	float cellStep = GetAxis(cellSize, axis);
+	if (cellStep <= 0.0f)
+	{
+		SplitFloat(1.0f, mantissa, exponent);
+		return;
+	}
+	SplitFloat(cellStep, mantissa, exponent);
+	exponent -= QUANTIZED_BITS - octreeDepth;
+}
+
+QuantizedTransform CollisionShape::GetQuantizedTransform(CollisionShape *otherShape, Vec3 offset)
+{
+	// Lattice coordinate u of the other shape lands on u * ratio + bias on the lattice of this shape
+	// Every float is split exactly into a mantissa and an exponent, so the ratio and the bias are found with integers only
+	// The bias is summed per term, rounding every term the same way, so it never shrinks the mapped boxes
+	QuantizedTransform transform;
+	for (int axis = 0; axis < 3; axis++)
+	{
+		int64_t stepMantissa, otherStepMantissa;
+		int stepExponent, otherStepExponent;
+		GetLatticeStep(axis, stepMantissa, stepExponent);
+		otherShape->GetLatticeStep(axis, otherStepMantissa, otherStepExponent);
+		int ratioShift = otherStepExponent - stepExponent + 16;
+		transform.lowScale[axis] = DivideFixed(otherStepMantissa, ratioShift, stepMantissa, false, MAX_FIXED_SCALE);
+		transform.highScale[axis] = DivideFixed(otherStepMantissa, ratioShift, stepMantissa, true, MAX_FIXED_SCALE);
+
+		float terms[3] = { GetAxis(otherShape->rootMin, axis), GetAxis(offset, axis), -GetAxis(rootMin, axis) };
+		transform.lowBias[axis] = 0;
+		transform.highBias[axis] = 0;
+		for (int i = 0; i < 3; i++)
+		{
+			int64_t termMantissa;
+			int termExponent;
+			SplitFloat(terms[i], termMantissa, termExponent);
+			int termShift = termExponent - stepExponent + 16;
+			transform.lowBias[axis] += DivideFixed(termMantissa, termShift, stepMantissa, false, MAX_FIXED_BIAS_TERM);
+			transform.highBias[axis] += DivideFixed(termMantissa, termShift, stepMantissa, true, MAX_FIXED_BIAS_TERM);
+		}
+	}
+	return transform;
+}
+
+BoundingSphere CollisionShape::GetBoundingSphere()
+{
+	return boundingSphere;
+}
+
+BoundingBox CollisionShape::GetBounds()
+{
+	return nodes.empty() ? BoundingBox() : GetNodeBounds(0);
+}
+
+int CollisionShape::GetOctreeDepth()
+{
+	return octreeDepth;
+}
+
+bool CollisionShape::MayCollide(CollisionShape *otherShape, Vec3 position, Vec3 otherPosition, int maxDepth)
+{
+	return CheckCollision(otherShape, position, otherPosition, maxDepth) != COLLISION_NONE;
+}
+
+CollisionResult CollisionShape::CheckCollision(CollisionShape *otherShape, Vec3 position, Vec3 otherPosition, int maxDepth)
+{
+	CollisionTransform transform = { position, CollisionRotation::Identity() };
+	CollisionTransform otherTransform = { otherPosition, CollisionRotation::Identity() };
+	return CheckCollision(otherShape, transform, otherTransform, maxDepth);
+}
+
+CollisionResult CollisionShape::CheckCollision(CollisionShape *otherShape, CollisionTransform transform,
+	CollisionTransform otherTransform, int maxDepth)
+{
+	if (nodes.empty() || otherShape->nodes.empty())
+		return COLLISION_NONE;
+
+	// Everything is checked in the frame of this shape
+	RelativeTransform relative = RelativeTransform::Create(transform, otherTransform);
+
+	// Quantized shapes skip the float sphere test so that the result only depends on the lattice
+	if (isQuantized && otherShape->isQuantized && !relative.isRotated)
+	{
+		QuantizedTransform quantized = GetQuantizedTransform(otherShape, relative.translation);
+		return CheckNodes(0, otherShape, 0, relative, &quantized, maxDepth);
+	}
+
+	// Reject on the bounding spheres first
+	BoundingSphere otherSphere = otherShape->boundingSphere;
+	Vec3 centerDistance = relative.Apply(otherSphere.center) - boundingSphere.center;
+	float radiusSum = boundingSphere.radius + otherSphere.radius;
+	if (centerDistance * centerDistance > radiusSum * radiusSum)
+		return COLLISION_NONE;
+
+	// Then descend the summary bounds
+	return CheckNodes(0, otherShape, 0, relative, nullptr, maxDepth);
+}
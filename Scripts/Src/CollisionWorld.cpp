@@ -0,0 +1,509 @@
+#include "CollisionWorld.h"
+#include <algorithm>
+
+// Number of worlds created so far, used to give every world its own collider prefix
+static std::atomic<int> worldCount;
+
+CollisionWorld::CollisionWorld()
+{
+	colliderPrefix = "World" + std::to_string(worldCount++) + "/";
+	isActive = true;
+	nextHandle = 0;
+	isStateRestored = false;
+	timeBudget = 0.0;
+}
+
+CollisionWorld::~CollisionWorld()
+{
+	// Bodies still in the queue are owned by the world as well
+	ApplyCommands();
+	for (auto body : bodies)
+	{
+		delete body;
+	}
+}
+
+void CollisionWorld::SetActive(bool isActive)
+{
+	this->isActive = isActive;
+}
+
+void CollisionWorld::SetViewPosition(Vec3 viewPosition)
+{
+	this->viewPosition = viewPosition;
+}
+
+std::string CollisionWorld::GetColliderName(std::string name)
+{
+	return colliderPrefix + name;
+}
+
+bool CollisionWorld::IsOverBudget()
+{
+	return timeBudget > 0.0 && std::chrono::steady_clock::now() >= deadline;
+}
+
+// The handle is given right away so that it can be used for filtering before the body is added
+void CollisionWorld::AddBody(CollisionBody *body)
+{
+	body->SetHandle(nextHandle.fetch_add(1));
+	PushCommand(COMMAND_ADD_BODY, body, "", Vec3());
+}
+
+void CollisionWorld::RemoveBody(std::string name)
+{
+	PushCommand(COMMAND_REMOVE_BODY, nullptr, name, Vec3());
+}
+
+void CollisionWorld::TranslateBody(CollisionBody *body, Vec3 translateVec)
+{
+	PushCommand(COMMAND_TRANSLATE, body, "", translateVec);
+}
+
+void CollisionWorld::SetBodyPosition(CollisionBody *body, Vec3 position)
+{
+	PushCommand(COMMAND_SET_POSITION, body, "", position);
+}
+
+void CollisionWorld::SetBodyRotation(CollisionBody *body, CollisionRotation rotation)
+{
+	CollisionCommand *command = new CollisionCommand();
+	command->type = COMMAND_SET_ROTATION;
+	command->body = body;
+	command->rotation = rotation;
+	commands.Push(command);
+}
+
+void CollisionWorld::UpdateBodyVertices(CollisionBody *body, std::vector<Vec3> &vertices)
+{
+	CollisionCommand *command = new CollisionCommand();
+	command->type = COMMAND_UPDATE_VERTICES;
+	command->body = body;
+	command->vertices = vertices;
+	commands.Push(command);
+}
+
+void CollisionWorld::PushCommand(CollisionCommandType type, CollisionBody *body, std::string name, Vec3 vector)
+{
+	CollisionCommand *command = new CollisionCommand();
+	command->type = type;
+	command->body = body;
+	command->name = name;
+	command->vector = vector;
+	commands.Push(command);
+}
+
+void CollisionWorld::ApplyCommands()
+{
+	while (CollisionCommand *command = commands.Pop())
+	{
+		switch (command->type)
+		{
+		case COMMAND_ADD_BODY:
+			ApplyAddBody(command->body);
+			break;
+		case COMMAND_REMOVE_BODY:
+			ApplyRemoveBody(command->name);
+			break;
+		case COMMAND_TRANSLATE:
+		{
+			Vec3 &position = state.GetArray<Vec3>(STATE_POSITIONS)[command->body->GetHandle()];
+			position = position + command->vector;
+			break;
+		}
+		case COMMAND_SET_POSITION:
+			state.GetArray<Vec3>(STATE_POSITIONS)[command->body->GetHandle()] = command->vector;
+			break;
+		case COMMAND_SET_ROTATION:
+			state.GetArray<CollisionRotation>(STATE_ROTATIONS)[command->body->GetHandle()] = command->rotation;
+			break;
+		case COMMAND_UPDATE_VERTICES:
+			command->body->ApplyVertexUpdate(command->vertices);
+			break;
+		}
+		delete command;
+	}
+}
+
+void CollisionWorld::ApplyAddBody(CollisionBody *body)
+{
+	// Bodies from different threads may arrive out of handle order
+	if (body->GetHandle() >= (int)bodiesByHandle.size())
+		bodiesByHandle.resize(body->GetHandle() + 1, nullptr);
+	bodiesByHandle[body->GetHandle()] = body;
+	bodies.push_back(body);
+	state.Reserve(body->GetHandle());
+}
+
+void CollisionWorld::ApplyRemoveBody(std::string name)
+{
+	auto it = std::find_if(bodies.begin(), bodies.end(),
+		[&name](CollisionBody *body) { return body->GetName() == name; });
+	if (it == bodies.end())
+		return;
+
+	// End the contacts of the removed body while it is still known
+	int handle = (*it)->GetHandle();
+	uint64_t *pairs = state.GetArray<uint64_t>(STATE_COLLIDING_PAIRS);
+	uint64_t *pairsEnd = pairs + state.GetCount(STATE_COLLIDING_PAIRS);
+	uint64_t *pairEnd = std::stable_partition(pairs, pairsEnd,
+		[handle](uint64_t pairKey) { return (int)(pairKey >> 32) != handle && (int)(pairKey & 0xFFFFFFFF) != handle; });
+	for (uint64_t *pair = pairEnd; pair != pairsEnd; pair++)
+	{
+		AddEvent(COLLISION_END, *pair);
+	}
+	state.Resize(STATE_COLLIDING_PAIRS, pairEnd - pairs);
+
+	// Drop the scheduling data of the pairs of the body
+	state.RemovePairsOfBody(handle);
+
+	bodiesByHandle[handle] = nullptr;
+	delete *it;
+	bodies.erase(it);
+}
+
+void CollisionWorld::IgnorePair(int handle, int otherHandle, bool ignore)
+{
+	if (ignore)
+		ignoredPairs.insert(GetPairKey(handle, otherHandle));
+	else
+		ignoredPairs.erase(GetPairKey(handle, otherHandle));
+}
+
+void CollisionWorld::SetPairFilter(CollisionFilter filter)
+{
+	pairFilter = filter;
+}
+
+uint64_t CollisionWorld::GetPairKey(int handle, int otherHandle)
+{
+	uint32_t low = (uint32_t)std::min(handle, otherHandle);
+	uint32_t high = (uint32_t)std::max(handle, otherHandle);
+	return ((uint64_t)low << 32) | high;
+}
+
+bool CollisionWorld::ShouldCollide(CollisionBody *body, CollisionBody *otherBody)
+{
+	if ((body->GetCategory() & otherBody->GetMask()) == 0 ||
+		(otherBody->GetCategory() & body->GetMask()) == 0)
+		return false;
+
+	if (!ignoredPairs.empty() &&
+		ignoredPairs.count(GetPairKey(body->GetHandle(), otherBody->GetHandle())) != 0)
+		return false;
+
+	if (pairFilter && !pairFilter(body->GetHandle(), otherBody->GetHandle()))
+		return false;
+
+	return true;
+}
+
+CollisionResult CollisionWorld::CheckCollision(CollisionBody *body, CollisionBody *otherBody)
+{
+	uint64_t pairKey = GetPairKey(body->GetHandle(), otherBody->GetHandle());
+	int *pairDepth = state.FindPairValue(STATE_PAIR_DEPTHS, pairKey);
+	int depth = pairDepth != nullptr ? *pairDepth : EARLY_OUT_DEPTH;
+
+	// Refine the pair until it is resolved or the budget runs out
+	CollisionResult result = body->CheckCollision(otherBody, depth);
+	while (result == COLLISION_POSSIBLE && !IsOverBudget())
+	{
+		depth++;
+		result = body->CheckCollision(otherBody, depth);
+	}
+
+	// Separated pairs start from the coarse depth again
+	if (result == COLLISION_NONE)
+		return COLLISION_NONE;
+	pairDepths.push_back({ pairKey, depth });
+
+	if (result == COLLISION_POSSIBLE)
+		return result;
+
+	// Compound and shared shape bodies have no library octree, the one of a deformed body is out of date
+	// and the one of a rotated body cannot rotate, so their leaf cells are final
+	if (!body->UsesColliderOctree() || !otherBody->UsesColliderOctree())
+		return COLLISION_CONFIRMED;
+
+	// Overlapping leaf cells still have to be confirmed against the library octree, so without budget left they are only possible
+	if (IsOverBudget())
+		return COLLISION_POSSIBLE;
+
+	// Colliders only follow the positions when they reach the library octree
+	body->SyncCollider(body->GetPosition());
+	otherBody->SyncCollider(otherBody->GetPosition());
+	return body->GetCollider()->CheckCollision(otherBody->GetCollider()) ? COLLISION_CONFIRMED : COLLISION_NONE;
+}
+
+// Bodies still waiting in the queue have no state yet
+Vec3 CollisionWorld::GetBodyPosition(int handle)
+{
+	return handle < (int)state.GetCount(STATE_POSITIONS) ? state.GetArray<Vec3>(STATE_POSITIONS)[handle] : Vec3();
+}
+
+CollisionRotation CollisionWorld::GetBodyRotation(int handle)
+{
+	return handle < (int)state.GetCount(STATE_ROTATIONS) ? state.GetArray<CollisionRotation>(STATE_ROTATIONS)[handle] : CollisionRotation::Identity();
+}
+
+int CollisionWorld::GetContactCount(int handle)
+{
+	return handle < (int)state.GetCount(STATE_CONTACT_COUNTS) ? state.GetArray<int>(STATE_CONTACT_COUNTS)[handle] : 0;
+}
+
+void CollisionWorld::SaveState(CollisionWorldState &snapshot)
+{
+	// The state is a single block, so saving is one copy that reuses the capacity of the snapshot
+	snapshot = state;
+}
+
+void CollisionWorld::SwapState(CollisionWorldState &snapshot)
+{
+	state.Swap(snapshot);
+
+	// Bodies added after the snapshot still need their slots
+	state.Reserve((int)bodiesByHandle.size() - 1);
+	isStateRestored = true;
+}
+
+void CollisionWorld::RefreshCollidedObjects()
+{
+	for (auto body : bodies)
+	{
+		if (body->GetCollider() != nullptr)
+			body->GetCollider()->CollidedObjects->clear();
+	}
+	uint64_t *pairs = state.GetArray<uint64_t>(STATE_COLLIDING_PAIRS);
+	for (size_t i = 0; i < state.GetCount(STATE_COLLIDING_PAIRS); i++)
+	{
+		uint64_t pairKey = pairs[i];
+		CollisionBody *body = bodiesByHandle[(int)(pairKey >> 32)];
+		CollisionBody *otherBody = bodiesByHandle[(int)(pairKey & 0xFFFFFFFF)];
+		if (body == nullptr || otherBody == nullptr)
+			continue;
+		body->BeginContact(otherBody->GetName());
+		otherBody->BeginContact(body->GetName());
+	}
+	isStateRestored = false;
+}
+
+std::vector<CollisionEvent> &CollisionWorld::GetEvents()
+{
+	return events;
+}
+
+std::vector<uint64_t> CollisionWorld::GetPossiblePairs()
+{
+	uint64_t *pairs = state.GetArray<uint64_t>(STATE_POSSIBLE_PAIRS);
+	return std::vector<uint64_t>(pairs, pairs + state.GetCount(STATE_POSSIBLE_PAIRS));
+}
+
+std::vector<uint64_t> CollisionWorld::GetStalePairs()
+{
+	uint64_t *pairs = state.GetArray<uint64_t>(STATE_STALE_PAIRS);
+	return std::vector<uint64_t>(pairs, pairs + state.GetCount(STATE_STALE_PAIRS));
+}
+
+bool CollisionWorld::WasColliding(uint64_t pairKey)
+{
+	uint64_t *pairs = state.GetArray<uint64_t>(STATE_COLLIDING_PAIRS);
+	return std::binary_search(pairs, pairs + state.GetCount(STATE_COLLIDING_PAIRS), pairKey);
+}
+
+float CollisionWorld::GetPairPriority(CollisionBody *body, CollisionBody *otherBody, uint64_t pairKey, int waitingLoops)
+{
+	float priority = 0.0f;
+	if (WasColliding(pairKey))
+		priority += RECENT_COLLISION_PRIORITY;
+
+	// Distance moved by both bodies since the previous loop
+	int handle = body->GetHandle(), otherHandle = otherBody->GetHandle();
+	Vec3 *positions = state.GetArray<Vec3>(STATE_POSITIONS);
+	Vec3 *previousPositions = state.GetArray<Vec3>(STATE_PREVIOUS_POSITIONS);
+	int previousCount = (int)state.GetCount(STATE_PREVIOUS_POSITIONS);
+	if (handle < previousCount && otherHandle < previousCount)
+	{
+		float speed = (positions[handle] - previousPositions[handle]).Magnitude() +
+			(positions[otherHandle] - previousPositions[otherHandle]).Magnitude();
+		priority += speed * SPEED_PRIORITY;
+	}
+
+	// Nearer pairs come first
+	float viewDistance = std::min((positions[handle] - viewPosition).Magnitude(),
+		(positions[otherHandle] - viewPosition).Magnitude());
+	priority += VIEW_PRIORITY / (1.0f + viewDistance);
+
+	// Pairs left unchecked rise until they are checked
+	priority += waitingLoops * WAITING_PRIORITY;
+
+	return priority;
+}
+
+void CollisionWorld::SchedulePairs()
+{
+	scheduledPairs.clear();
+	for (size_t i = 0; i < bodies.size(); i++)
+	{
+		for (size_t j = i + 1; j < bodies.size(); j++)
+		{
+			if (!ShouldCollide(bodies[i], bodies[j]))
+				continue;
+
+			ScheduledPair pair;
+			pair.body = bodies[i];
+			pair.otherBody = bodies[j];
+			pair.pairKey = GetPairKey(bodies[i]->GetHandle(), bodies[j]->GetHandle());
+			pair.waitingLoops = 0;
+			pair.priority = 0.0f;
+			if (timeBudget > 0.0)
+			{
+				int *waitingLoops = state.FindPairValue(STATE_PAIR_WAITING_LOOPS, pair.pairKey);
+				if (waitingLoops != nullptr)
+					pair.waitingLoops = *waitingLoops;
+				pair.priority = GetPairPriority(bodies[i], bodies[j], pair.pairKey, pair.waitingLoops);
+			}
+			scheduledPairs.push_back(pair);
+		}
+	}
+
+	// Without a budget every pair is checked, so the order does not matter
+	if (timeBudget > 0.0)
+	{
+		// Pairs that waited too long are not weighed against the others, so a pair far from the view cannot starve
+		std::sort(scheduledPairs.begin(), scheduledPairs.end(),
+			[](const ScheduledPair &pair, const ScheduledPair &otherPair)
+			{
+				bool isStarved = pair.waitingLoops >= MAX_WAITING_LOOPS;
+				bool isOtherStarved = otherPair.waitingLoops >= MAX_WAITING_LOOPS;
+				if (isStarved != isOtherStarved)
+					return isStarved;
+				if (isStarved && pair.waitingLoops != otherPair.waitingLoops)
+					return pair.waitingLoops > otherPair.waitingLoops;
+				return pair.priority > otherPair.priority;
+			});
+	}
+}
+
+void CollisionWorld::AddEvent(CollisionEventType type, uint64_t pairKey)
+{
+	CollisionEvent event;
+	event.type = type;
+	event.handle = (int)(pairKey >> 32);
+	event.otherHandle = (int)(pairKey & 0xFFFFFFFF);
+	pendingEvents.push_back(event);
+
+	int contactChange = type == COLLISION_BEGIN ? 1 : -1;
+	int *contactCounts = state.GetArray<int>(STATE_CONTACT_COUNTS);
+	contactCounts[event.handle] += contactChange;
+	contactCounts[event.otherHandle] += contactChange;
+
+	CollisionBody *body = bodiesByHandle[event.handle];
+	CollisionBody *otherBody = bodiesByHandle[event.otherHandle];
+	if (body == nullptr || otherBody == nullptr)
+		return;
+
+	if (type == COLLISION_BEGIN)
+	{
+		body->BeginContact(otherBody->GetName());
+		otherBody->BeginContact(body->GetName());
+	}
+	else
+	{
+		body->EndContact(otherBody->GetName());
+		otherBody->EndContact(body->GetName());
+	}
+}
+
+void CollisionWorld::UpdateEvents()
+{
+	std::sort(collidingPairs.begin(), collidingPairs.end());
+
+	// Merge the sorted pair lists, pairs only in the current list begin and pairs only in the previous list end
+	uint64_t *previousPairs = state.GetArray<uint64_t>(STATE_COLLIDING_PAIRS);
+	size_t previousCount = state.GetCount(STATE_COLLIDING_PAIRS);
+	size_t current = 0, previous = 0;
+	while (current < collidingPairs.size() || previous < previousCount)
+	{
+		if (previous == previousCount ||
+			(current < collidingPairs.size() && collidingPairs[current] < previousPairs[previous]))
+		{
+			AddEvent(COLLISION_BEGIN, collidingPairs[current++]);
+		}
+		else if (current == collidingPairs.size() || previousPairs[previous] < collidingPairs[current])
+		{
+			AddEvent(COLLISION_END, previousPairs[previous++]);
+		}
+		else
+		{
+			current++;
+			previous++;
+		}
+	}
+
+	state.Assign(STATE_COLLIDING_PAIRS, collidingPairs.data(), collidingPairs.size());
+	collidingPairs.clear();
+
+	std::swap(events, pendingEvents);
+	pendingEvents.clear();
+}
+
+// Function to check collision between every pair of bodies
+void CollisionWorld::CollisionLoop(double timeBudget)
+{
+	// Mutations are applied even when inactive so that the bodies stay in sync
+	ApplyCommands();
+
+	if (isStateRestored)
+		RefreshCollidedObjects();
+
+	if (!isActive)
+		return;
+
+	this->timeBudget = timeBudget;
+	deadline = std::chrono::steady_clock::now() +
+		std::chrono::microseconds((long long)timeBudget);
+	state.Resize(STATE_POSSIBLE_PAIRS, 0);
+	state.Resize(STATE_STALE_PAIRS, 0);
+	pairDepths.clear();
+	pairWaitingLoops.clear();
+
+	// The octree test is symmetric, so every pair is checked once
+	SchedulePairs();
+	bool isFirstPair = true;
+	for (auto &pair : scheduledPairs)
+	{
+		// Pairs that do not fit in the budget keep their last result until a later loop
+		// The first pair is always checked so that the waiting pairs move forward
+		if (IsOverBudget() && !isFirstPair)
+		{
+			pairWaitingLoops.push_back({ pair.pairKey, pair.waitingLoops + 1 });
+			int *pairDepth = state.FindPairValue(STATE_PAIR_DEPTHS, pair.pairKey);
+			if (pairDepth != nullptr)
+				pairDepths.push_back({ pair.pairKey, *pairDepth });
+			if (WasColliding(pair.pairKey))
+				collidingPairs.push_back(pair.pairKey);
+			state.Push(STATE_STALE_PAIRS, &pair.pairKey);
+			continue;
+		}
+		isFirstPair = false;
+
+		// Possible collisions are reported as colliding so that the result stays conservative
+		CollisionResult result = CheckCollision(pair.body, pair.otherBody);
+		if (result == COLLISION_NONE)
+			continue;
+
+		collidingPairs.push_back(pair.pairKey);
+		if (result == COLLISION_POSSIBLE)
+			state.Push(STATE_POSSIBLE_PAIRS, &pair.pairKey);
+	}
+
+	// Pairs are checked in order of priority, so the new pair data is sorted by key before it replaces the old
+	auto isKeyLess = [](const PairValue &value, const PairValue &otherValue) { return value.pairKey < otherValue.pairKey; };
+	std::sort(pairDepths.begin(), pairDepths.end(), isKeyLess);
+	std::sort(pairWaitingLoops.begin(), pairWaitingLoops.end(), isKeyLess);
+	state.Assign(STATE_PAIR_DEPTHS, pairDepths.data(), pairDepths.size());
+	state.Assign(STATE_PAIR_WAITING_LOOPS, pairWaitingLoops.data(), pairWaitingLoops.size());
+
+	state.CopyArray(STATE_PREVIOUS_POSITIONS, STATE_POSITIONS);
+	UpdateEvents();
+}
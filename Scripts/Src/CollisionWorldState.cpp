@@ -0,0 +1,145 @@
+#include "CollisionWorldState.h"
+#include <cstring>
+#include <algorithm>
+
+// Size of an element of each array, in the order of CollisionStateArray
+static const size_t STATE_ELEMENT_SIZES[STATE_ARRAY_COUNT] =
+{
+	sizeof(Vec3), sizeof(CollisionRotation), sizeof(int), sizeof(Vec3),
+	sizeof(uint64_t), sizeof(uint64_t), sizeof(uint64_t),
+	sizeof(PairValue), sizeof(PairValue)
+};
+
+// Alignment of the arrays in the block and the capacity an array starts with once it is used
+const size_t STATE_ARRAY_ALIGNMENT = 16;
+const size_t STATE_MIN_CAPACITY = 16;
+
+CollisionWorldState::CollisionWorldState()
+{
+	block.resize(sizeof(CollisionStateHeader));
+	CollisionStateHeader *header = GetHeader();
+	for (int i = 0; i < STATE_ARRAY_COUNT; i++)
+	{
+		header->offsets[i] = sizeof(CollisionStateHeader);
+		header->counts[i] = 0;
+		header->capacities[i] = 0;
+	}
+}
+
+CollisionStateHeader *CollisionWorldState::GetHeader()
+{
+	return (CollisionStateHeader*)block.data();
+}
+
+void CollisionWorldState::Grow(CollisionStateArray array, size_t count)
+{
+	CollisionStateHeader header = *GetHeader();
+	header.capacities[array] = (uint32_t)std::max(count, std::max((size_t)header.capacities[array] * 2, STATE_MIN_CAPACITY));
+
+	// Lay the arrays out one after the other and copy their elements over
+	std::vector<char> grownBlock;
+	size_t offset = sizeof(CollisionStateHeader);
+	uint64_t offsets[STATE_ARRAY_COUNT];
+	for (int i = 0; i < STATE_ARRAY_COUNT; i++)
+	{
+		offset = (offset + STATE_ARRAY_ALIGNMENT - 1) & ~(STATE_ARRAY_ALIGNMENT - 1);
+		offsets[i] = offset;
+		offset += header.capacities[i] * STATE_ELEMENT_SIZES[i];
+	}
+	grownBlock.resize(offset);
+	for (int i = 0; i < STATE_ARRAY_COUNT; i++)
+	{
+		memcpy(grownBlock.data() + offsets[i], block.data() + header.offsets[i], header.counts[i] * STATE_ELEMENT_SIZES[i]);
+		header.offsets[i] = offsets[i];
+	}
+	memcpy(grownBlock.data(), &header, sizeof(header));
+	block.swap(grownBlock);
+}
+
+size_t CollisionWorldState::GetCount(CollisionStateArray array)
+{
+	return GetHeader()->counts[array];
+}
+
+void CollisionWorldState::Resize(CollisionStateArray array, size_t count)
+{
+	if (count > GetHeader()->capacities[array])
+	{
+		Grow(array, count);
+	}
+	GetHeader()->counts[array] = (uint32_t)count;
+}
+
+void CollisionWorldState::Assign(CollisionStateArray array, const void *values, size_t count)
+{
+	Resize(array, count);
+	memcpy(GetArray<char>(array), values, count * STATE_ELEMENT_SIZES[array]);
+}
+
+void CollisionWorldState::Push(CollisionStateArray array, const void *value)
+{
+	size_t count = GetCount(array);
+	Resize(array, count + 1);
+	memcpy(GetArray<char>(array) + count * STATE_ELEMENT_SIZES[array], value, STATE_ELEMENT_SIZES[array]);
+}
+
+void CollisionWorldState::CopyArray(CollisionStateArray array, CollisionStateArray sourceArray)
+{
+	// Resizing first, so the source is read from where it lies after the block grew
+	size_t count = GetCount(sourceArray);
+	Resize(array, count);
+	memcpy(GetArray<char>(array), GetArray<char>(sourceArray), count * STATE_ELEMENT_SIZES[array]);
+}
+
+int *CollisionWorldState::FindPairValue(CollisionStateArray array, uint64_t pairKey)
+{
+	PairValue *values = GetArray<PairValue>(array);
+	PairValue *end = values + GetCount(array);
+	PairValue *value = std::lower_bound(values, end, pairKey,
+		[](const PairValue &pairValue, uint64_t key) { return pairValue.pairKey < key; });
+	if (value == end || value->pairKey != pairKey)
+		return nullptr;
+	return &value->value;
+}
+
+void CollisionWorldState::RemovePairsOfBody(int handle)
+{
+	auto isPairOfBody = [handle](uint64_t pairKey) { return (int)(pairKey >> 32) == handle || (int)(pairKey & 0xFFFFFFFF) == handle; };
+
+	for (CollisionStateArray array : { STATE_POSSIBLE_PAIRS, STATE_STALE_PAIRS })
+	{
+		uint64_t *pairs = GetArray<uint64_t>(array);
+		Resize(array, std::remove_if(pairs, pairs + GetCount(array), isPairOfBody) - pairs);
+	}
+	for (CollisionStateArray array : { STATE_PAIR_DEPTHS, STATE_PAIR_WAITING_LOOPS })
+	{
+		PairValue *values = GetArray<PairValue>(array);
+		Resize(array, std::remove_if(values, values + GetCount(array),
+			[&isPairOfBody](const PairValue &value) { return isPairOfBody(value.pairKey); }) - values);
+	}
+}
+
+void CollisionWorldState::Reserve(int handle)
+{
+	size_t bodyCount = GetCount(STATE_POSITIONS);
+	if (handle < (int)bodyCount)
+		return;
+	Resize(STATE_POSITIONS, handle + 1);
+	Resize(STATE_ROTATIONS, handle + 1);
+	Resize(STATE_CONTACT_COUNTS, handle + 1);
+
+	Vec3 *positions = GetArray<Vec3>(STATE_POSITIONS);
+	CollisionRotation *rotations = GetArray<CollisionRotation>(STATE_ROTATIONS);
+	int *contactCounts = GetArray<int>(STATE_CONTACT_COUNTS);
+	for (size_t i = bodyCount; i <= (size_t)handle; i++)
+	{
+		positions[i] = Vec3();
+		rotations[i] = CollisionRotation::Identity();
+		contactCounts[i] = 0;
+	}
+}
+
+void CollisionWorldState::Swap(CollisionWorldState &other)
+{
+	block.swap(other.block);
+}
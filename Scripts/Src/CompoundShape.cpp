@@ -0,0 +1,218 @@
+#include "CompoundShape.h"
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+
+// Function to get the coordinate of one axis of a vector
+static float GetAxis(Vec3 vector, int axis)
+{
+	return axis == 0 ? vector.x : axis == 1 ? vector.y : vector.z;
+}
+
+// Function to combine the results of two checks, a confirmed collision wins over a possible one
+static CollisionResult CombineResults(CollisionResult result, CollisionResult otherResult)
+{
+	return std::max(result, otherResult);
+}
+
+// Function to get the box enclosing a box placed by a rigid transform
+static BoundingBox TransformBounds(BoundingBox bounds, CollisionTransform transform)
+{
+	Vec3 center = (bounds.minPosition + bounds.maxPosition) * 0.5;
+	Vec3 extent = (bounds.maxPosition - bounds.minPosition) * 0.5;
+	Vec3 placedCenter = transform.rotation.Rotate(center) + transform.position;
+	float placedExtent[3];
+	for (int i = 0; i < 3; i++)
+	{
+		placedExtent[i] = fabsf(transform.rotation.values[i][0]) * extent.x + fabsf(transform.rotation.values[i][1]) * extent.y +
+			fabsf(transform.rotation.values[i][2]) * extent.z;
+	}
+	Vec3 placedExtentVector(placedExtent[0], placedExtent[1], placedExtent[2]);
+
+	BoundingBox placed;
+	placed.minPosition = placedCenter - placedExtentVector;
+	placed.maxPosition = placedCenter + placedExtentVector;
+	return placed;
+}
+
+CompoundShape::CompoundShape(std::vector<std::vector<Vec3>> &parts, std::vector<CollisionTransform> &localTransforms, int octreeDepth)
+{
+	if (parts.empty() || parts.size() != localTransforms.size())
+	{
+		throw std::runtime_error("compound shape needs one local transform for every part!");
+	}
+
+	// Every part gets an octree fitted to its own vertices
+	for (size_t i = 0; i < parts.size(); i++)
+	{
+		if (parts[i].empty())
+		{
+			throw std::runtime_error("compound shape part has no vertices!");
+		}
+
+		Vec3 rootMin = parts[i][0];
+		Vec3 rootMax = parts[i][0];
+		for (auto vertex : parts[i])
+		{
+			rootMin = Vec3(std::min(rootMin.x, vertex.x), std::min(rootMin.y, vertex.y), std::min(rootMin.z, vertex.z));
+			rootMax = Vec3(std::max(rootMax.x, vertex.x), std::max(rootMax.y, vertex.y), std::max(rootMax.z, vertex.z));
+		}
+
+		CompoundChild child;
+		child.shape = new CollisionShape(parts[i], rootMin, rootMax, octreeDepth);
+		child.localTransform = localTransforms[i];
+		child.bounds = TransformBounds(child.shape->GetBounds(), child.localTransform);
+		children.push_back(child);
+	}
+
+	std::vector<int> childIndices(children.size());
+	for (size_t i = 0; i < children.size(); i++)
+	{
+		childIndices[i] = i;
+	}
+	nodes.reserve(2 * children.size() - 1);
+	BuildNode(childIndices, 0, childIndices.size());
+}
+
+CompoundShape::~CompoundShape()
+{
+	for (auto child : children)
+	{
+		delete child.shape;
+	}
+}
+
+int CompoundShape::BuildNode(std::vector<int> &childIndices, int begin, int end)
+{
+	int nodeIndex = nodes.size();
+	nodes.push_back(CompoundNode());
+
+	BoundingBox bounds = children[childIndices[begin]].bounds;
+	for (int i = begin + 1; i < end; i++)
+	{
+		bounds = BoundingBox::Merge(bounds, children[childIndices[i]].bounds);
+	}
+	nodes[nodeIndex].bounds = bounds;
+
+	if (end - begin == 1)
+	{
+		nodes[nodeIndex].left = -1;
+		nodes[nodeIndex].right = -1;
+		nodes[nodeIndex].child = childIndices[begin];
+		return nodeIndex;
+	}
+
+	// Split at the median of the centers along the longest axis
+	Vec3 extent = bounds.maxPosition - bounds.minPosition;
+	int axis = extent.x >= extent.y && extent.x >= extent.z ? 0 : extent.y >= extent.z ? 1 : 2;
+	int middle = (begin + end) / 2;
+	std::nth_element(childIndices.begin() + begin, childIndices.begin() + middle, childIndices.begin() + end,
+		[this, axis](int a, int b)
+		{
+			BoundingBox boundsA = children[a].bounds;
+			BoundingBox boundsB = children[b].bounds;
+			return GetAxis(boundsA.minPosition, axis) + GetAxis(boundsA.maxPosition, axis) <
+				GetAxis(boundsB.minPosition, axis) + GetAxis(boundsB.maxPosition, axis);
+		});
+
+	// Nodes are accessed by index since building the children grows the node array
+	int left = BuildNode(childIndices, begin, middle);
+	int right = BuildNode(childIndices, middle, end);
+	nodes[nodeIndex].child = -1;
+	nodes[nodeIndex].left = left;
+	nodes[nodeIndex].right = right;
+	return nodeIndex;
+}
+
+int CompoundShape::GetChildCount()
+{
+	return children.size();
+}
+
+CompoundChild CompoundShape::GetChild(int index)
+{
+	return children[index];
+}
+
+void CompoundShape::SetQuantized(bool isQuantized)
+{
+	for (auto child : children)
+	{
+		child.shape->SetQuantized(isQuantized);
+	}
+}
+
+// Function to place a child by its local transform followed by the transform of its compound shape
+static CollisionTransform GetChildTransform(CollisionTransform transform, CompoundChild &child)
+{
+	CollisionTransform childTransform;
+	childTransform.position = transform.position + transform.rotation.Rotate(child.localTransform.position);
+	childTransform.rotation = transform.rotation.Multiply(child.localTransform.rotation);
+	return childTransform;
+}
+
+CollisionResult CompoundShape::CheckNode(int node, CollisionShape *otherShape, BoundingBox otherBounds,
+	CollisionTransform &transform, CollisionTransform &otherTransform, RelativeTransform &relative, int maxDepth)
+{
+	CompoundNode &current = nodes[node];
+	if (!BoundingBox::Overlaps(current.bounds, otherBounds, relative))
+		return COLLISION_NONE;
+
+	if (current.child != -1)
+	{
+		CompoundChild &child = children[current.child];
+		return child.shape->CheckCollision(otherShape, GetChildTransform(transform, child), otherTransform, maxDepth);
+	}
+
+	CollisionResult result = CheckNode(current.left, otherShape, otherBounds, transform, otherTransform, relative, maxDepth);
+	if (result == COLLISION_CONFIRMED)
+		return result;
+	return CombineResults(result, CheckNode(current.right, otherShape, otherBounds, transform, otherTransform, relative, maxDepth));
+}
+
+CollisionResult CompoundShape::CheckNodes(int node, CompoundShape *otherShape, int otherNode,
+	CollisionTransform &transform, CollisionTransform &otherTransform, RelativeTransform &relative, int maxDepth)
+{
+	CompoundNode &current = nodes[node];
+	CompoundNode &other = otherShape->nodes[otherNode];
+	if (!BoundingBox::Overlaps(current.bounds, other.bounds, relative))
+		return COLLISION_NONE;
+
+	if (current.child != -1 && other.child != -1)
+	{
+		CompoundChild &child = children[current.child];
+		CompoundChild &otherChild = otherShape->children[other.child];
+		return child.shape->CheckCollision(otherChild.shape, GetChildTransform(transform, child),
+			GetChildTransform(otherTransform, otherChild), maxDepth);
+	}
+
+	// Descend the node with the larger bounds so that the boxes shrink evenly
+	Vec3 extent = current.bounds.maxPosition - current.bounds.minPosition;
+	Vec3 otherExtent = other.bounds.maxPosition - other.bounds.minPosition;
+	if (other.child != -1 || (current.child == -1 && extent * extent >= otherExtent * otherExtent))
+	{
+		CollisionResult result = CheckNodes(current.left, otherShape, otherNode, transform, otherTransform, relative, maxDepth);
+		if (result == COLLISION_CONFIRMED)
+			return result;
+		return CombineResults(result, CheckNodes(current.right, otherShape, otherNode, transform, otherTransform, relative, maxDepth));
+	}
+
+	CollisionResult result = CheckNodes(node, otherShape, other.left, transform, otherTransform, relative, maxDepth);
+	if (result == COLLISION_CONFIRMED)
+		return result;
+	return CombineResults(result, CheckNodes(node, otherShape, other.right, transform, otherTransform, relative, maxDepth));
+}
+
+CollisionResult CompoundShape::CheckCollision(CollisionShape *otherShape, CollisionTransform transform,
+	CollisionTransform otherTransform, int maxDepth)
+{
+	RelativeTransform relative = RelativeTransform::Create(transform, otherTransform);
+	return CheckNode(0, otherShape, otherShape->GetBounds(), transform, otherTransform, relative, maxDepth);
+}
+
+CollisionResult CompoundShape::CheckCollision(CompoundShape *otherShape, CollisionTransform transform,
+	CollisionTransform otherTransform, int maxDepth)
+{
+	RelativeTransform relative = RelativeTransform::Create(transform, otherTransform);
+	return CheckNodes(0, otherShape, 0, transform, otherTransform, relative, maxDepth);
+}
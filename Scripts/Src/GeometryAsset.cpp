@@ -0,0 +1,549 @@
+#include "GeometryAsset.h"
+#include "ObjReader.h"
+#include "MeshOptimizer.h"
+#include "MeshSimplifier.h"
+#include <algorithm>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <stdexcept>
+#include <cmath>
+
+std::mutex GeometryAsset::assetsMutex;
+std::unordered_map<std::string, GeometryAsset*> GeometryAsset::assets;
+
+static const char MESH_CACHE_MAGIC[8] = { 'M', 'E', 'S', 'H', 'B', 'I', 'N', '\0' };
+
+// Function to round an offset up to the alignment of the blobs
+static uint64_t AlignOffset(uint64_t offset)
+{
+	return (offset + MESH_CACHE_ALIGNMENT - 1) / MESH_CACHE_ALIGNMENT * MESH_CACHE_ALIGNMENT;
+}
+
+// Function to check whether a blob of the cache lies within the file
+static bool IsBlobInFile(uint64_t offset, uint64_t count, uint64_t elementSize, uint64_t fileSize)
+{
+	return offset % MESH_CACHE_ALIGNMENT == 0 && offset <= fileSize && count <= (fileSize - offset) / elementSize;
+}
+
+GeometryAsset::GeometryAsset(const char *filename)
+{
+	this->filename = filename;
+	referenceCount = 0;
+	pendingUploadCount = 0;
+	cacheFile = nullptr;
+	vertices = nullptr;
+	vertexCount = 0;
+	indices = nullptr;
+	indexCount = 0;
+	positions = nullptr;
+	positionCount = 0;
+	isDataLoaded = false;
+	hasLoaded = false;
+}
+
+void GeometryAsset::AcquireData()
+{
+	std::lock_guard<std::mutex> lock(dataMutex);
+	if (!isDataLoaded)
+	{
+		try
+		{
+			if (hasLoaded)
+				ReloadData();
+			else
+				LoadData();
+		}
+		catch (...)
+		{
+			ReleaseData();
+			throw;
+		}
+		hasLoaded = true;
+	}
+	pendingUploadCount++;
+}
+
+void GeometryAsset::LoadData()
+{
+	// The size and write time of the model tell whether the cache was written from its current contents
+	std::error_code error;
+	sourceSize = std::filesystem::file_size(filename, error);
+	if (error)
+	{
+		throw std::runtime_error("failed to open model file!");
+	}
+	sourceTime = std::filesystem::last_write_time(filename, error).time_since_epoch().count();
+
+	std::string cachePath = GetCachePath(filename.c_str());
+	if (!LoadCache(cachePath, sourceSize, sourceTime))
+	{
+		Import();
+		WriteCache(cachePath, sourceSize, sourceTime);
+	}
+	isDataLoaded = true;
+}
+
+void GeometryAsset::ReloadData()
+{
+	// The geometry is loaded into an asset of its own, so the levels of detail read by the render thread are left alone
+	GeometryAsset *reloaded = new GeometryAsset(filename.c_str());
+	try
+	{
+		reloaded->LoadData();
+	}
+	catch (...)
+	{
+		delete reloaded;
+		throw;
+	}
+
+	// Meshes uploaded earlier still draw the levels of detail of the first load
+	bool isSame = reloaded->vertexCount == vertexCount && reloaded->indexCount == indexCount && reloaded->lods.size() == lods.size();
+	for (size_t i = 0; i < lods.size() && isSame; i++)
+	{
+		isSame = reloaded->lods[i].indexOffset == lods[i].indexOffset && reloaded->lods[i].indexCount == lods[i].indexCount;
+	}
+	if (!isSame)
+	{
+		delete reloaded;
+		throw std::runtime_error("model file changed while its meshes are loaded!");
+	}
+
+	vertices = reloaded->vertices;
+	indices = reloaded->indices;
+	importedVertices.swap(reloaded->importedVertices);
+	importedIndices.swap(reloaded->importedIndices);
+	importedPositions.swap(reloaded->importedPositions);
+	positions = reloaded->positions;
+	positionCount = reloaded->positionCount;
+	std::swap(cacheFile, reloaded->cacheFile);
+	isDataLoaded = true;
+	delete reloaded;
+}
+
+void GeometryAsset::ReleaseData()
+{
+	std::vector<Vertex>().swap(importedVertices);
+	std::vector<uint32_t>().swap(importedIndices);
+	std::vector<float>().swap(importedPositions);
+	delete cacheFile;
+	cacheFile = nullptr;
+	vertices = nullptr;
+	indices = nullptr;
+	positions = nullptr;
+	isDataLoaded = false;
+}
+
+GeometryAsset::~GeometryAsset()
+{
+	delete cacheFile;
+}
+
+void GeometryAsset::Import()
+{
+	MappedFile file(filename.c_str());
+	ObjReader reader(file.GetData(), file.GetSize());
+	reader.Parse(importedVertices, importedIndices);
+
+	// The positions of the reader are laid out per axis, so that they can be viewed in place from here on
+	std::vector<Vec3> &readPositions = reader.GetPositions();
+	positionCount = readPositions.size();
+	importedPositions.resize(positionCount * 3);
+	for (size_t i = 0; i < positionCount; i++)
+	{
+		importedPositions[i] = readPositions[i].x;
+		importedPositions[positionCount + i] = readPositions[i].y;
+		importedPositions[2 * positionCount + i] = readPositions[i].z;
+	}
+	positions = importedPositions.data();
+	materialFilename = reader.GetMaterialFilename();
+	ComputeBounds();
+
+	importACMR = MeshOptimizer::GetACMR(importedIndices.data(), importedIndices.size(), importedVertices.size());
+	optimizedACMR = importACMR;
+	if (OPTIMIZE_IMPORTED_MESHES)
+	{
+		MeshOptimizer::OptimizeTriangles(importedVertices, importedIndices);
+	}
+
+	GenerateLods();
+
+	// Every level is drawn from the one vertex buffer, so the vertices are ordered once over all of them
+	if (OPTIMIZE_IMPORTED_MESHES)
+	{
+		MeshOptimizer::OptimizeVertexFetch(importedVertices, importedIndices);
+		optimizedACMR = MeshOptimizer::GetACMR(importedIndices.data(), lods[0].indexCount, importedVertices.size());
+		if (PRINT_MESH_STATISTICS)
+		{
+			std::cout << "Optimized " << filename << ": ACMR " << importACMR << " -> " << optimizedACMR << std::endl;
+		}
+	}
+
+	vertices = importedVertices.data();
+	vertexCount = importedVertices.size();
+	indices = importedIndices.data();
+	indexCount = importedIndices.size();
+}
+
+void GeometryAsset::GenerateLods()
+{
+	lods.clear();
+	lods.push_back({ 0, (uint32_t)importedIndices.size(), 0.0f });
+
+	Vec3 extent = maxPosition - minPosition;
+	float maxError = (float)std::sqrt(extent * extent) * MESH_LOD_MAX_ERROR;
+
+	// Each level is simplified from the one before it, so its error is at most the sum of the errors so far
+	std::vector<uint32_t> lodIndices(importedIndices);
+	std::vector<uint32_t> simplifiedIndices;
+	for (int lod = 1; lod < MESH_LOD_COUNT; lod++)
+	{
+		float error = MeshSimplifier::Simplify(importedVertices.data(), importedVertices.size(), lodIndices,
+			lodIndices.size() / 6 * 3, maxError, simplifiedIndices);
+
+		// Stop once a level no longer removes a useful share of the triangles
+		if (simplifiedIndices.empty() || simplifiedIndices.size() > lodIndices.size() * 9 / 10)
+			break;
+
+		if (OPTIMIZE_IMPORTED_MESHES)
+		{
+			MeshOptimizer::OptimizeTriangles(importedVertices, simplifiedIndices);
+		}
+		lods.push_back({ (uint32_t)importedIndices.size(), (uint32_t)simplifiedIndices.size(), lods.back().error + error });
+		importedIndices.insert(importedIndices.end(), simplifiedIndices.begin(), simplifiedIndices.end());
+		lodIndices.swap(simplifiedIndices);
+	}
+
+	if (PRINT_MESH_STATISTICS)
+	{
+		std::cout << "Generated " << lods.size() << " levels of detail for " << filename << ":";
+		for (auto &lod : lods)
+		{
+			std::cout << " " << lod.indexCount / 3;
+		}
+		std::cout << " triangles" << std::endl;
+	}
+}
+
+void GeometryAsset::ComputeBounds()
+{
+	PositionView view = GetPositions();
+	minPosition = view.size() == 0 ? Vec3() : view[0];
+	maxPosition = minPosition;
+	for (size_t i = 0; i < view.size(); i++)
+	{
+		Vec3 position = view[i];
+		minPosition = Vec3(std::min(minPosition.x, position.x), std::min(minPosition.y, position.y), std::min(minPosition.z, position.z));
+		maxPosition = Vec3(std::max(maxPosition.x, position.x), std::max(maxPosition.y, position.y), std::max(maxPosition.z, position.z));
+	}
+}
+
+bool GeometryAsset::LoadCache(std::string cachePath, uint64_t sourceSize, int64_t sourceTime)
+{
+	std::error_code error;
+	if (!std::filesystem::exists(cachePath, error))
+		return false;
+
+	MappedFile *file;
+	try
+	{
+		file = new MappedFile(cachePath.c_str());
+	}
+	catch (std::runtime_error &)
+	{
+		return false;
+	}
+
+	// Reject caches of another version, of another build of Vertex, of other settings, of an older model or cut short
+	uint64_t fileSize = file->GetSize();
+	const char *data = file->GetData();
+	MeshCacheHeader header;
+	bool isValid = fileSize >= sizeof(MeshCacheHeader);
+	if (isValid)
+	{
+		memcpy(&header, data, sizeof(MeshCacheHeader));
+		isValid = memcmp(header.magic, MESH_CACHE_MAGIC, sizeof(header.magic)) == 0 &&
+			header.version == MESH_CACHE_VERSION && header.vertexSize == sizeof(Vertex) &&
+			header.isOptimized == (OPTIMIZE_IMPORTED_MESHES ? 1u : 0u) &&
+			header.maxLodCount == (uint32_t)MESH_LOD_COUNT && header.lodCount >= 1 &&
+			header.lodMaxError == MESH_LOD_MAX_ERROR && header.vertexCacheSize == (uint32_t)VERTEX_CACHE_SIZE &&
+			header.overdrawThreshold == OVERDRAW_THRESHOLD &&
+			IsBlobInFile(header.lodOffset, header.lodCount, sizeof(MeshLod), fileSize) &&
+			header.sourceSize == sourceSize && header.sourceTime == sourceTime &&
+			IsBlobInFile(header.vertexOffset, header.vertexCount, sizeof(Vertex), fileSize) &&
+			IsBlobInFile(header.indexOffset, header.indexCount, sizeof(uint32_t), fileSize) &&
+			IsBlobInFile(header.positionOffset, header.positionCount, 3 * sizeof(float), fileSize) &&
+			IsBlobInFile(header.materialOffset, header.materialLength, 1, fileSize);
+	}
+
+	// Every level of detail has to lie within the indices
+	if (isValid)
+	{
+		const MeshLod *cachedLods = (const MeshLod*)(data + header.lodOffset);
+		for (uint32_t i = 0; i < header.lodCount && isValid; i++)
+		{
+			isValid = cachedLods[i].indexCount % 3 == 0 &&
+				(uint64_t)cachedLods[i].indexOffset + cachedLods[i].indexCount <= header.indexCount;
+		}
+	}
+
+	// Every index has to name a stored vertex, else a broken cache would make the draws read past the vertex buffer
+	if (isValid)
+	{
+		const uint32_t *cachedIndices = (const uint32_t*)(data + header.indexOffset);
+		uint32_t maxIndex = 0;
+		for (uint64_t i = 0; i < header.indexCount; i++)
+		{
+			maxIndex = std::max(maxIndex, cachedIndices[i]);
+		}
+		isValid = header.indexCount == 0 || maxIndex < header.vertexCount;
+	}
+	if (!isValid)
+	{
+		delete file;
+		return false;
+	}
+
+	cacheFile = file;
+	vertices = (Vertex*)(data + header.vertexOffset);
+	vertexCount = header.vertexCount;
+	indices = (uint32_t*)(data + header.indexOffset);
+	indexCount = header.indexCount;
+	positions = (const float*)(data + header.positionOffset);
+	positionCount = header.positionCount;
+	materialFilename.assign(data + header.materialOffset, header.materialLength);
+	minPosition = Vec3(header.minPosition[0], header.minPosition[1], header.minPosition[2]);
+	maxPosition = Vec3(header.maxPosition[0], header.maxPosition[1], header.maxPosition[2]);
+	importACMR = header.importACMR;
+	optimizedACMR = header.optimizedACMR;
+	const MeshLod *cachedLods = (const MeshLod*)(data + header.lodOffset);
+	lods.assign(cachedLods, cachedLods + header.lodCount);
+	return true;
+}
+
+bool GeometryAsset::WriteCache(std::string cachePath, uint64_t sourceSize, int64_t sourceTime)
+{
+	MeshCacheHeader header = {};
+	memcpy(header.magic, MESH_CACHE_MAGIC, sizeof(header.magic));
+	header.version = MESH_CACHE_VERSION;
+	header.vertexSize = sizeof(Vertex);
+	header.sourceSize = sourceSize;
+	header.sourceTime = sourceTime;
+	header.vertexCount = vertexCount;
+	header.indexCount = indexCount;
+	header.positionCount = positionCount;
+	header.materialLength = materialFilename.size();
+	header.vertexOffset = AlignOffset(sizeof(MeshCacheHeader));
+	header.indexOffset = AlignOffset(header.vertexOffset + vertexCount * sizeof(Vertex));
+	header.positionOffset = AlignOffset(header.indexOffset + indexCount * sizeof(uint32_t));
+	header.lodOffset = AlignOffset(header.positionOffset + positionCount * 3 * sizeof(float));
+	header.materialOffset = AlignOffset(header.lodOffset + lods.size() * sizeof(MeshLod));
+	header.minPosition[0] = minPosition.x;
+	header.minPosition[1] = minPosition.y;
+	header.minPosition[2] = minPosition.z;
+	header.maxPosition[0] = maxPosition.x;
+	header.maxPosition[1] = maxPosition.y;
+	header.maxPosition[2] = maxPosition.z;
+	header.isOptimized = OPTIMIZE_IMPORTED_MESHES ? 1 : 0;
+	header.importACMR = importACMR;
+	header.optimizedACMR = optimizedACMR;
+	header.maxLodCount = MESH_LOD_COUNT;
+	header.lodCount = (uint32_t)lods.size();
+	header.lodMaxError = MESH_LOD_MAX_ERROR;
+	header.vertexCacheSize = VERTEX_CACHE_SIZE;
+	header.overdrawThreshold = OVERDRAW_THRESHOLD;
+
+	// Write to a temporary file and rename it, so that a cache is either complete or missing
+	std::string temporaryPath = cachePath + ".tmp";
+	std::error_code error;
+	{
+		std::ofstream outputFile(temporaryPath, std::ios::binary | std::ios::trunc);
+		if (!outputFile.is_open())
+			return false;
+
+		const char padding[MESH_CACHE_ALIGNMENT] = {};
+		auto writeBlob = [&outputFile, &padding](uint64_t offset, const void *blob, uint64_t size)
+		{
+			outputFile.write(padding, offset - (uint64_t)outputFile.tellp());
+			outputFile.write((const char*)blob, size);
+		};
+		outputFile.write((const char*)&header, sizeof(MeshCacheHeader));
+		writeBlob(header.vertexOffset, vertices, vertexCount * sizeof(Vertex));
+		writeBlob(header.indexOffset, indices, indexCount * sizeof(uint32_t));
+		writeBlob(header.positionOffset, positions, positionCount * 3 * sizeof(float));
+		writeBlob(header.lodOffset, lods.data(), lods.size() * sizeof(MeshLod));
+		writeBlob(header.materialOffset, materialFilename.data(), materialFilename.size());
+		if (!outputFile.good())
+		{
+			outputFile.close();
+			std::filesystem::remove(temporaryPath, error);
+			return false;
+		}
+	}
+
+	std::filesystem::rename(temporaryPath, cachePath, error);
+	if (error)
+	{
+		std::filesystem::remove(temporaryPath, error);
+		return false;
+	}
+	return true;
+}
+
+GeometryAsset * GeometryAsset::Load(const char *filename)
+{
+	// The registry is only locked to find or add the asset, so that other files are read meanwhile
+	GeometryAsset *asset;
+	{
+		std::lock_guard<std::mutex> lock(assetsMutex);
+		GeometryAsset *&entry = assets[filename];
+		if (entry == nullptr)
+		{
+			entry = new GeometryAsset(filename);
+		}
+		asset = entry;
+		asset->referenceCount++;
+	}
+
+	// A failed read gives the reference up again, the last one drops the asset from the registry
+	try
+	{
+		asset->AcquireData();
+	}
+	catch (...)
+	{
+		asset->Release();
+		throw;
+	}
+	return asset;
+}
+
+std::string GeometryAsset::GetCachePath(const char *filename)
+{
+	return std::filesystem::path(filename).replace_extension(".meshbin").string();
+}
+
+void GeometryAsset::Release()
+{
+	std::lock_guard<std::mutex> lock(assetsMutex);
+	referenceCount--;
+	if (referenceCount > 0)
+		return;
+	assets.erase(filename);
+	delete this;
+}
+
+void GeometryAsset::FinishUpload(bool releaseData)
+{
+	std::lock_guard<std::mutex> lock(dataMutex);
+	pendingUploadCount--;
+	if (releaseData && pendingUploadCount == 0)
+	{
+		ReleaseData();
+	}
+}
+
+bool GeometryAsset::IsDataLoaded()
+{
+	std::lock_guard<std::mutex> lock(dataMutex);
+	return isDataLoaded;
+}
+
+size_t GeometryAsset::GetMemoryUsage()
+{
+	std::lock_guard<std::mutex> lock(dataMutex);
+	return importedVertices.capacity() * sizeof(Vertex) + importedIndices.capacity() * sizeof(uint32_t) +
+		importedPositions.capacity() * sizeof(float) + lods.capacity() * sizeof(MeshLod) +
+		(cacheFile != nullptr ? cacheFile->GetSize() : 0);
+}
+
+std::string GeometryAsset::GetFilename()
+{
+	return filename;
+}
+
+std::string GeometryAsset::GetMaterialFilename()
+{
+	return materialFilename;
+}
+
+bool GeometryAsset::IsLoadedFromCache()
+{
+	return cacheFile != nullptr;
+}
+
+float GeometryAsset::GetImportACMR()
+{
+	return importACMR;
+}
+
+float GeometryAsset::GetOptimizedACMR()
+{
+	return optimizedACMR;
+}
+
+Vertex * GeometryAsset::GetVertices()
+{
+	return vertices;
+}
+
+size_t GeometryAsset::GetVertexCount()
+{
+	return vertexCount;
+}
+
+uint32_t * GeometryAsset::GetIndices()
+{
+	return indices;
+}
+
+size_t GeometryAsset::GetIndexCount()
+{
+	return indexCount;
+}
+
+PositionView GeometryAsset::GetPositions()
+{
+	return PositionView(positions, positions + positionCount, positions + 2 * positionCount, positionCount);
+}
+
+Vec3 GeometryAsset::GetMinPosition()
+{
+	return minPosition;
+}
+
+Vec3 GeometryAsset::GetMaxPosition()
+{
+	return maxPosition;
+}
+
+int GeometryAsset::GetLodCount()
+{
+	return (int)lods.size();
+}
+
+MeshLod GeometryAsset::GetLod(int lod)
+{
+	return lods[lod];
+}
+
+void GeometryAsset::GetLodPositions(int lod, std::vector<Vec3> &lodPositions)
+{
+	std::vector<bool> isUsed(vertexCount, false);
+	lodPositions.clear();
+	for (uint32_t i = lods[lod].indexOffset; i < lods[lod].indexOffset + lods[lod].indexCount; i++)
+	{
+		if (isUsed[indices[i]])
+			continue;
+		isUsed[indices[i]] = true;
+		lodPositions.push_back(vertices[indices[i]].position);
+	}
+
+	// Vertices on a seam share their position, so the positions are made distinct
+	auto isLess = [](Vec3 &a, Vec3 &b) { return a.x != b.x ? a.x < b.x : a.y != b.y ? a.y < b.y : a.z < b.z; };
+	auto isEqual = [](Vec3 &a, Vec3 &b) { return a.x == b.x && a.y == b.y && a.z == b.z; };
+	std::sort(lodPositions.begin(), lodPositions.end(), isLess);
+	lodPositions.erase(std::unique(lodPositions.begin(), lodPositions.end(), isEqual), lodPositions.end());
+}
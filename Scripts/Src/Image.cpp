@@ -41,6 +41,7 @@ void Image::createImage(Device *device,uint32_t width, uint32_t height, VkFormat
 	allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
 	allocInfo.allocationSize = memRequirements.size;
 	allocInfo.memoryTypeIndex = device->findMemoryType(memRequirements.memoryTypeBits, properties);
+	allocationSize = memRequirements.size;
 
 	if (vkAllocateMemory(device->logicalDevice, &allocInfo, nullptr, &memory) != VK_SUCCESS) {
 		throw std::runtime_error("failed to allocate image memory!");
@@ -0,0 +1,110 @@
+#include "MappedFile.h"
+#include <stdexcept>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#ifdef _WIN32
+MappedFile::MappedFile(const char *filename)
+{
+	data = nullptr;
+	size = 0;
+	mappingHandle = nullptr;
+	fileHandle = CreateFileA(filename, GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING,
+		FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+	if (fileHandle == INVALID_HANDLE_VALUE)
+	{
+		throw std::runtime_error("failed to open file to map!");
+	}
+
+	LARGE_INTEGER fileSize;
+	if (!GetFileSizeEx(fileHandle, &fileSize))
+	{
+		CloseHandle(fileHandle);
+		throw std::runtime_error("failed to get size of file to map!");
+	}
+	size = (size_t)fileSize.QuadPart;
+
+	// Empty files cannot be mapped, they are left as an empty view
+	if (size == 0)
+		return;
+
+	mappingHandle = CreateFileMappingA(fileHandle, nullptr, PAGE_READONLY, 0, 0, nullptr);
+	if (mappingHandle == nullptr)
+	{
+		CloseHandle(fileHandle);
+		throw std::runtime_error("failed to create file mapping!");
+	}
+	data = (const char*)MapViewOfFile(mappingHandle, FILE_MAP_READ, 0, 0, 0);
+	if (data == nullptr)
+	{
+		CloseHandle(mappingHandle);
+		CloseHandle(fileHandle);
+		throw std::runtime_error("failed to map view of file!");
+	}
+}
+
+MappedFile::~MappedFile()
+{
+	if (data != nullptr)
+		UnmapViewOfFile(data);
+	if (mappingHandle != nullptr)
+		CloseHandle(mappingHandle);
+	CloseHandle(fileHandle);
+}
+#else
+MappedFile::MappedFile(const char *filename)
+{
+	data = nullptr;
+	size = 0;
+	fileDescriptor = open(filename, O_RDONLY);
+	if (fileDescriptor < 0)
+	{
+		throw std::runtime_error("failed to open file to map!");
+	}
+
+	struct stat fileStat;
+	if (fstat(fileDescriptor, &fileStat) != 0)
+	{
+		close(fileDescriptor);
+		throw std::runtime_error("failed to get size of file to map!");
+	}
+	size = (size_t)fileStat.st_size;
+	if (size == 0)
+		return;
+
+	void *view = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fileDescriptor, 0);
+	if (view == MAP_FAILED)
+	{
+		close(fileDescriptor);
+		throw std::runtime_error("failed to map view of file!");
+	}
+	madvise(view, size, MADV_SEQUENTIAL);
+	data = (const char*)view;
+}
+
+MappedFile::~MappedFile()
+{
+	if (data != nullptr)
+		munmap((void*)data, size);
+	close(fileDescriptor);
+}
+#endif
+
+const char * MappedFile::GetData()
+{
+	return data;
+}
+
+size_t MappedFile::GetSize()
+{
+	return size;
+}
@@ -1,8 +1,10 @@
 #include "Mesh.h"
-#include "CollisionEngine\Collider.h"
+#include "CollisionWorld.h"
 #include "UI_Design.h"
 #include <fstream>
 #include <string>
+#include <atomic>
+#include <algorithm>
 
 std::vector<VkDescriptorSet> Mesh::CreateObjectDescriptorSets(VkDescriptorSetLayout descriptorSetLayout,
 	VkDescriptorPool descriptorPool,
@@ -73,26 +75,82 @@ std::vector<VkDescriptorSet> Mesh::CreateObjectDescriptorSets(VkDescriptorSetLay
 }
 Mesh::Mesh()
 {
+	vertexFormat = VERTEX_FORMAT_FULL;
+	isReady = false;
+	geometry = nullptr;
+	collisionBody = nullptr;
+	rotationMatrix = glm::mat4(1.0f);
+	aabbIndexCount = 0;
+}
 
+Mesh::Mesh(const char * filename, Vec3 position, Device *device,CommandPool *commandPool,int swapChainCount, CollisionWorld *collisionWorld)
+	: Mesh(position, device, commandPool, swapChainCount)
+{
+	LoadAsset(filename, collisionWorld);
+	Upload();
 }
 
-Mesh::Mesh(const char * filename, Vec3 position, Device *device,CommandPool *commandPool,int swapChainCount)
+Mesh::Mesh(Vec3 position, Device *device, CommandPool *commandPool, int swapChainCount)
 {
 	this->device = device;
 	this->commandPool = commandPool;
 	this->swapChainCount = swapChainCount;
 	this->position = position;
 	this->isStatic = false;
-	ParseObjFile(filename);
-	ConstructAABBMesh();
+	this->isReady = false;
+	geometry = nullptr;
+	collisionBody = nullptr;
+	rotationMatrix = glm::mat4(1.0f);
+	vertexFormat = MESH_VERTEX_FORMAT;
+	currentLod = 0;
+	aabbIndexCount = 0;
+	dequantization.scale = Vec3(1.0f, 1.0f, 1.0f);
+	aabbDequantization = dequantization;
+}
 
-	collider->Translate(position * -1);
+void Mesh::LoadAsset(const char * filename, CollisionWorld *collisionWorld)
+{
+	LoadGeometry(filename);
+	ConstructAABBMesh(collisionWorld);
+
+	collisionBody->Translate(position * -1);
 
+	PackVertices();
+}
+
+void Mesh::PackVertices()
+{
+	// The full layout is uploaded straight from the geometry
+	if (vertexFormat == VERTEX_FORMAT_FULL)
+		return;
+
+	dequantization = VertexPacker::PackVertices(geometry->GetVertices(), geometry->GetVertexCount(), vertexFormat,
+		geometry->GetMinPosition(), geometry->GetMaxPosition(), packedVertices);
+
+	Vec3 aabbMinPosition, aabbMaxPosition;
+	VertexPacker::GetBounds(aabbVertices.data(), aabbVertices.size(), aabbMinPosition, aabbMaxPosition);
+	aabbDequantization = VertexPacker::PackVertices(aabbVertices.data(), aabbVertices.size(), vertexFormat,
+		aabbMinPosition, aabbMaxPosition, packedAABBVertices);
+}
+
+bool Mesh::IsReady()
+{
+	return isReady;
+}
+
+int Mesh::GetCurrentLod()
+{
+	return currentLod;
+}
+
+void Mesh::Upload()
+{
 	// Create Vertex Buffer
 	createVertexBuffer();
 
-	// Create the instance buffer
-	InstanceBuffer = new Buffer(device, pow(10, 6) * sizeof(InstanceData), VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+	// Create the instance buffer, only for the single instance drawn in memory budget mode
+	VkDeviceSize instanceBufferSize = MEMORY_BUDGET_MODE ? sizeof(InstanceData) : pow(10, 6) * sizeof(InstanceData);
+	InstanceBuffer = new Buffer(device, instanceBufferSize, VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
 
 	// Create Index Buffer
 	createIndexBuffer();
@@ -109,114 +167,78 @@ Mesh::Mesh(const char * filename, Vec3 position, Device *device,CommandPool *com
 	// Create the Uniform Buffers
 	createUniformBuffers();
 
+	// Apply a static flag set before the collision body existed
+	// The category is read by the collision loop, so it is only written on the render thread
+	SetStatic(isStatic);
+
+	// The collision body was built on load, so nothing reads the arrays anymore
+	ReleaseUploadData();
+
+	isReady = true;
 }
 
-Mesh::~Mesh()
+void Mesh::ReleaseUploadData()
 {
+	if (MEMORY_BUDGET_MODE)
+	{
+		std::vector<Vertex>().swap(aabbVertices);
+		std::vector<int>().swap(aabbIndices);
+	}
+	geometry->FinishUpload(MEMORY_BUDGET_MODE);
 }
 
-void Mesh::ParseObjFile(const char * filename)
+MeshMemoryUsage Mesh::GetMemoryUsage()
 {
-	std::vector<Vec3> positions;
-	std::vector<Vec3> normals;
-	std::vector<Vec3> texCoords;
-	std::ifstream inputFile;
-	inputFile.open(filename);
-	if (!inputFile.is_open())
+	MeshMemoryUsage usage = {};
+	usage.hostBytes = aabbVertices.capacity() * sizeof(Vertex) + aabbIndices.capacity() * sizeof(int) +
+		packedVertices.capacity() + packedAABBVertices.capacity();
+	usage.sharedHostBytes = geometry != nullptr ? geometry->GetMemoryUsage() : 0;
+	if (!isReady)
+		return usage;
+
+	usage.deviceBytes = VertexBuffer->allocationSize + IndexBuffer->allocationSize + InstanceBuffer->allocationSize +
+		AABBVertexBuffer->allocationSize + AABBIndexBuffer->allocationSize +
+		opacityImage->textureImage->allocationSize + aabbOpacityImage->textureImage->allocationSize;
+	for (size_t i = 0; i < swapChainCount; i++)
 	{
-		throw std::runtime_error("failed to open obj file!");
+		usage.deviceBytes += uniformBuffers[i]->allocationSize + lightingBuffers[i]->allocationSize +
+			aabbUniformBuffers[i]->allocationSize + aabbLightingBuffers[i]->allocationSize +
+			drawCommandBuffers[i]->allocationSize;
 	}
+	return usage;
+}
 
+Mesh::~Mesh()
+{
+}
 
-	std::string tempString = "";
-	int i;
-	while (true)
-	{
-		inputFile >> tempString;
-		if (tempString == "mtllib")
-		{
-			std::string materialFilename;
-			inputFile >> materialFilename;
-			LoadMaterial(materialFilename.c_str());
-		}
-		if (tempString == "v")
-		{
-			float x, y, z;
-			inputFile >> x >> y >> z;
-			Vec3 v;
-			v.x = x;
-			v.y = y;
-			v.z = z;
-
-			positions.push_back(v);
-		}
-		else if (tempString == "vn")
-		{
-			float x, y, z;
-			inputFile >> x >> y >> z;
-			Vec3 v;
-			v.x = x;
-			v.y = y;
-			v.z = z;
-
-			normals.push_back(v);
-		}
-		else if (tempString == "vt")
-		{
-			float x, y, z;
-			inputFile >> x >> y >> z;
-			Vec3 v;
-			v.x = x;
-			v.y = 1 - y;
-			v.z = z;
-			texCoords.push_back(v);
-		}
-
-		else if (tempString == "f")
-		{
-			for (int j = 0; j < 3; j++)
-			{
-				int position_index, tex_index, normal_index;
-				inputFile >> tempString;
-				std::string tstring = tempString;
-				position_index = atoi(strtok(&tempString[0], "/"));
-				tex_index = atoi(strtok(NULL, "/"));
-				normal_index = atoi(strtok(NULL, "/"));
-				Vertex v;
-				v.position = positions[position_index - 1];
-				Vec3 color;
-				color.x = 1.0f;
-				color.y = 1.0f;
-				color.z = 1.0f;
-
-				v.color = color;
-				v.tex = texCoords[tex_index - 1];
-				v.normal = normals[normal_index - 1];
-
-				vertices.push_back(v);
-			}
-			int vertex_index = vertices.size();
-			indices.push_back(vertex_index - 3);
-			indices.push_back(vertex_index - 2);
-			indices.push_back(vertex_index - 1);
+void Mesh::LoadGeometry(const char * filename)
+{
+	geometry = GeometryAsset::Load(filename);
 
-		}
-		else if (inputFile.eof())
-			break;
+	std::string materialFilename = geometry->GetMaterialFilename();
+	if (!materialFilename.empty())
+	{
+		LoadMaterial(materialFilename.c_str());
 	}
 }
 
-void Mesh::ConstructAABBMesh()
+void Mesh::ConstructAABBMesh(CollisionWorld *collisionWorld)
 {
-	static int count;
-	std::vector<Vec3> positions;
-	for (auto vertex : vertices)
+	// Meshes may be loaded on several threads at once, so every body takes its own number
+	static std::atomic<int> count;
+	if (COLLISION_PROXY_LOD > 0 && geometry->GetLodCount() > 1)
 	{
-		positions.push_back(vertex.position);
+		std::vector<Vec3> proxyPositions;
+		geometry->GetLodPositions(std::min(COLLISION_PROXY_LOD, geometry->GetLodCount() - 1), proxyPositions);
+		collisionBody = new CollisionBody(collisionWorld, "Object" + std::to_string(count++), proxyPositions, 6);
+	}
+	else
+	{
+		collisionBody = new CollisionBody(collisionWorld, "Object" + std::to_string(count++), geometry->GetPositions(), 6);
 	}
-	collider = new Collider("Object" +count,positions,6);
 
-	AxisAlignedBoundingBox aabb = *collider->GetAABB();
+	AxisAlignedBoundingBox aabb = *collisionBody->GetCollider()->GetAABB();
 
 	std::vector<Vec3> aabbPositions = aabb.GetOctreeVertices();//  aabb.GetVertices();
 	std::vector<Vec3> aabbTexCoords = aabb.GetTexCoords();
@@ -231,7 +253,7 @@ void Mesh::ConstructAABBMesh()
 		int vertex_index = aabbVertices.size();
 		aabbIndices.push_back(vertex_index - 1);
 	}
-	count++;
+	aabbIndexCount = static_cast<uint32_t>(aabbIndices.size());
 }
 
 void Mesh::LoadMaterial(const char * filename)
@@ -282,21 +304,29 @@ void Mesh::LoadMaterial(const char * filename)
 
 // Function to create Index Buffer
 void Mesh::createIndexBuffer() {
-	VkDeviceSize bufferSize = sizeof(indices[0]) * indices.size();
+	VkDeviceSize bufferSize = sizeof(uint32_t) * geometry->GetIndexCount();
 
 	IndexBuffer = new Buffer(device, bufferSize, VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_INDEX_BUFFER_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
 
-	IndexBuffer->SetDataUsingStageBuffer(device, indices.data(), bufferSize, commandPool);
+	IndexBuffer->SetDataUsingStageBuffer(device, geometry->GetIndices(), bufferSize, commandPool);
 }
 
 // Function to create Vertex Buffer
 void Mesh::createVertexBuffer() {
-
-	VkDeviceSize bufferSize = sizeof(vertices[0]) * vertices.size();
+	VkDeviceSize bufferSize = sizeof(Vertex) * geometry->GetVertexCount();
+	void *vertexData = geometry->GetVertices();
+	if (vertexFormat != VERTEX_FORMAT_FULL)
+	{
+		bufferSize = packedVertices.size();
+		vertexData = packedVertices.data();
+	}
 
 	VertexBuffer = new Buffer(device, bufferSize, VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
 
-	VertexBuffer->SetDataUsingStageBuffer(device, vertices.data(), bufferSize, commandPool);
+	VertexBuffer->SetDataUsingStageBuffer(device, vertexData, bufferSize, commandPool);
+
+	// The packed copy is only needed for the upload
+	std::vector<uint8_t>().swap(packedVertices);
 }
 
 // Function to create Index Buffer
@@ -312,10 +342,19 @@ void Mesh::createAABBIndexBuffer() {
 void Mesh::createAABBVertexBuffer() {
 
 	VkDeviceSize bufferSize = sizeof(aabbVertices[0]) * aabbVertices.size();
+	void *vertexData = aabbVertices.data();
+	if (vertexFormat != VERTEX_FORMAT_FULL)
+	{
+		bufferSize = packedAABBVertices.size();
+		vertexData = packedAABBVertices.data();
+	}
 
 	AABBVertexBuffer = new Buffer(device, bufferSize, VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
 
-	AABBVertexBuffer->SetDataUsingStageBuffer(device, aabbVertices.data(), bufferSize, commandPool);
+	AABBVertexBuffer->SetDataUsingStageBuffer(device, vertexData, bufferSize, commandPool);
+
+	// The packed copy is only needed for the upload
+	std::vector<uint8_t>().swap(packedAABBVertices);
 }
 
 void Mesh::Draw(VkCommandBuffer commandBuffer, Pipeline graphicsPipeline, int currentImage)
@@ -336,9 +375,8 @@ void Mesh::Draw(VkCommandBuffer commandBuffer, Pipeline graphicsPipeline, int cu
 	// Bind descriptor sets
 	graphicsPipeline.BindDescriptorSets(commandBuffer, descriptorSets[currentImage]);
 
-	// Draw the meshes
-	vkCmdDrawIndexed(commandBuffer,
-		static_cast<uint32_t>(indices.size()), 1, 0, 0, 0);
+	// Draw the meshes, the index range of the level of detail is written to the indirect command every frame
+	vkCmdDrawIndexedIndirect(commandBuffer, drawCommandBuffers[currentImage]->buffer, 0, 1, sizeof(VkDrawIndexedIndirectCommand));
 }
 
 void Mesh::DrawAABB(VkCommandBuffer commandBuffer, Pipeline graphicsPipeline, int currentImage)
@@ -357,13 +395,24 @@ void Mesh::DrawAABB(VkCommandBuffer commandBuffer, Pipeline graphicsPipeline, in
 
 	// Draw the meshes
 	vkCmdDrawIndexed(commandBuffer,
-		static_cast<uint32_t>(aabbIndices.size()), 1,
+		aabbIndexCount, 1,
 		0, 0, 0);
 
 }
 
 void Mesh::Cleanup()
 {
+	// A mesh still loading holds no device resources yet
+	if (!isReady)
+	{
+		if (geometry != nullptr)
+		{
+			geometry->FinishUpload(MEMORY_BUDGET_MODE);
+			geometry->Release();
+		}
+		return;
+	}
+
 	// Destroy the index buffer
 	IndexBuffer->Cleanup(device);
 
@@ -381,6 +430,8 @@ void Mesh::Cleanup()
 	opacityImage->Cleanup(device);
 
 	aabbOpacityImage->Cleanup(device);
+
+	geometry->Release();
 }
 
 void Mesh::CleanupUniformBuffers()
@@ -395,12 +446,20 @@ void Mesh::CleanupUniformBuffers()
 		aabbUniformBuffers[i]->Cleanup(device);
 
 		aabbLightingBuffers[i]->Cleanup(device);
+
+		drawCommandBuffers[i]->Cleanup(device);
 	}
 }
 
 void Mesh::SetStatic(bool isStatic)
 {
 	this->isStatic = isStatic;
+	if (collisionBody == nullptr)
+		return;
+
+	// Static meshes are never tested against each other
+	collisionBody->SetCategory(isStatic ? COLLISION_CATEGORY_STATIC : COLLISION_CATEGORY_DEFAULT);
+	collisionBody->SetMask(isStatic ? COLLISION_MASK_ALL & ~COLLISION_CATEGORY_STATIC : COLLISION_MASK_ALL);
 }
 
 // Function to create descriptor sets for each Vk Buffer
@@ -414,38 +473,91 @@ void Mesh::createDescriptorSets(VkDescriptorSetLayout descriptorSetLayout,
 		aabbUniformBuffers, aabbLightingBuffers, aabbOpacityImage);
 }
 
+// Function to convert the rotation of a model matrix to the rotation of a collision body
+static CollisionRotation GetCollisionRotation(glm::mat4 rotationMatrix)
+{
+	CollisionRotation rotation;
+	for (int row = 0; row < 3; row++)
+		for (int column = 0; column < 3; column++)
+			rotation.values[row][column] = rotationMatrix[column][row];
+	return rotation;
+}
+
 // Function to update uniform buffer values
 void Mesh::updateUniformBuffer(uint32_t currentImage, Window window, Swapchain *swapChain) {
 
 	UniformBufferObject ubo = {};
 
+	// Only a moving mesh follows the arcball rotation, and its collider is only rotated when the rotation changed
+	if (!isStatic && window.ShouldUpdate() && window.GetRotationMatrix() != rotationMatrix)
+	{
+		rotationMatrix = window.GetRotationMatrix();
+		collisionBody->SetRotation(GetCollisionRotation(rotationMatrix));
+	}
+
 	if (!isStatic && window.ShouldUpdate())
 	{
 		glm::vec3 translateVec = window.GetTranslateValues();
 		position = position - Vec3(translateVec.x, translateVec.y, translateVec.z);
-		collider->Translate(Vec3(translateVec.x, translateVec.y, translateVec.z));
+		collisionBody->Translate(Vec3(translateVec.x, translateVec.y, translateVec.z));
 		ubo.model = glm::scale(glm::mat4(1.0f), glm::vec3(UIDesign::uiParams.scale)) *
 			glm::translate(glm::mat4(1), glm::vec3(position.x, position.y, position.z)) *
-			window.GetRotationMatrix();
+			rotationMatrix;
 	}
 	else
 	{ 
 	ubo.model = glm::scale(glm::mat4(1.0f),glm::vec3(UIDesign::uiParams.scale)) *
 			glm::translate(glm::mat4(1), glm::vec3(position.x, position.y, position.z)) *
-			window.GetRotationMatrix();
+			rotationMatrix;
 	}
 	ubo.view = glm::lookAt(glm::vec3(0.0f, 2.0f, 100.0f), 
 		 glm::vec3(0.0f, 0.0f, 40.0f), glm::vec3(0.0f, 0.0f, 1.0f));
 
 	ubo.proj = glm::perspective(glm::radians(45.0f),
 		swapChain->swapChainExtent.width / (float)swapChain->swapChainExtent.height, 0.1f, 1000.0f);
+
+	// Draw the level of detail that fits the size of the mesh on screen
+	// proj[1][1] is the inverse tangent of half the field of view, so it turns view space heights into screen heights
+	currentLod = SelectLod(ubo.view * ubo.model, ubo.proj[1][1] * swapChain->swapChainExtent.height);
+	MeshLod lod = geometry->GetLod(currentLod);
+	VkDrawIndexedIndirectCommand drawCommand = {};
+	drawCommand.indexCount = lod.indexCount;
+	drawCommand.instanceCount = 1;
+	drawCommand.firstIndex = lod.indexOffset;
+	drawCommandBuffers[currentImage]->SetData(device, &drawCommand, sizeof(drawCommand));
+
 	ubo.proj[1][1] *= -1;
 
+	ubo.positionScale = glm::vec4(dequantization.scale.x, dequantization.scale.y, dequantization.scale.z, 0.0f);
+	ubo.positionOffset = glm::vec4(dequantization.offset.x, dequantization.offset.y, dequantization.offset.z, 0.0f);
 	uniformBuffers[currentImage]->SetData(device, &ubo, sizeof(ubo));
 	//ubo.model = ubo.model * glm::inverse(window.GetRotationMatrix());
+	ubo.positionScale = glm::vec4(aabbDequantization.scale.x, aabbDequantization.scale.y, aabbDequantization.scale.z, 0.0f);
+	ubo.positionOffset = glm::vec4(aabbDequantization.offset.x, aabbDequantization.offset.y, aabbDequantization.offset.z, 0.0f);
 	aabbUniformBuffers[currentImage]->SetData(device, &ubo, sizeof(ubo));
 }
 
+// Function to select the level of detail from the projected error of the levels
+int Mesh::SelectLod(glm::mat4 modelView, float screenHeight)
+{
+	// Distance of the centre of the bounds in front of the camera
+	Vec3 center = (geometry->GetMinPosition() + geometry->GetMaxPosition()) * 0.5;
+	glm::vec4 viewCenter = modelView * glm::vec4(center.x, center.y, center.z, 1.0f);
+	float distance = std::max(-viewCenter.z, 0.1f);
+
+	// Pixels covered by a model unit at that distance, the model matrix scales uniformly
+	float pixelsPerUnit = UIDesign::uiParams.scale * screenHeight * 0.5f / distance;
+
+	int lod = 0;
+	for (int i = 1; i < geometry->GetLodCount(); i++)
+	{
+		if (geometry->GetLod(i).error * pixelsPerUnit > UIDesign::uiParams.lodPixelError)
+			break;
+		lod = i;
+	}
+	return lod;
+}
+
 // Function to update lighting constant values
 void Mesh::updateLightingConstants(uint32_t currentImage, Window window, Swapchain *swapChain) {
 	LightingConstants lightConstants = lightingConstants;
@@ -453,7 +565,7 @@ void Mesh::updateLightingConstants(uint32_t currentImage, Window window, Swapcha
 	Matrix4 rot = window.GetLightRotationMatrix();
 	//lightConstants.lightPosition = rot * Vec4{ 0.0, 10.0, 100.0, 1.0 };// glm::vec4(85.0f, 2.0f, 100.0f, 1.0)* rot;//;
 
-	lightConstants.isCollided = collider->IsCollidedWithAny();
+	lightConstants.isCollided = collisionBody->IsCollidedWithAny();
 	lightConstants.useOpacityMap = false;
 	lightConstants.showAABB = UIDesign::uiParams.renderAABB;
 	lightingBuffers[currentImage]->SetData(device, &lightConstants, sizeof(lightConstants));
@@ -473,11 +585,13 @@ void Mesh::createUniformBuffers() {
 
 	lightingBuffers.resize(swapChainCount);
 	aabbLightingBuffers.resize(swapChainCount);
+	drawCommandBuffers.resize(swapChainCount);
 
 	for (size_t i = 0; i < swapChainCount; i++) {
 		uniformBuffers[i] = new Buffer(device, bufferSize, VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
 		lightingBuffers[i] = new Buffer(device, lightingBufferSize, VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
 		aabbUniformBuffers[i] = new Buffer(device, bufferSize, VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
 		aabbLightingBuffers[i] = new Buffer(device, lightingBufferSize, VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+		drawCommandBuffers[i] = new Buffer(device, sizeof(VkDrawIndexedIndirectCommand), VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
 	}
 }
\ No newline at end of file
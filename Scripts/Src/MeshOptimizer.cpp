@@ -0,0 +1,290 @@
+#include "MeshOptimizer.h"
+#include <algorithm>
+#include <cmath>
+#include <numeric>
+
+void MeshOptimizer::Optimize(std::vector<Vertex> &vertices, std::vector<uint32_t> &indices)
+{
+	OptimizeTriangles(vertices, indices);
+	OptimizeVertexFetch(vertices, indices);
+}
+
+void MeshOptimizer::OptimizeTriangles(const std::vector<Vertex> &vertices, std::vector<uint32_t> &indices)
+{
+	if (indices.empty())
+		return;
+
+	std::vector<size_t> clusters;
+	OptimizeVertexCache(indices, vertices.size(), clusters);
+	float cacheRatio = GetACMR(indices.data(), indices.size(), vertices.size());
+
+	// Sorting restarts the cache at every cluster, so the finer clusters are tried first, then the Tipsify clusters,
+	// and the Tipsify order is kept if both lose more than the threshold
+	std::vector<size_t> splitClusters = clusters;
+	SplitClusters(indices, vertices.size(), splitClusters);
+	for (auto candidate : { &splitClusters, &clusters })
+	{
+		std::vector<uint32_t> sortedIndices = indices;
+		OptimizeOverdraw(sortedIndices, vertices.data(), *candidate);
+		if (GetACMR(sortedIndices.data(), sortedIndices.size(), vertices.size()) <= cacheRatio * OVERDRAW_THRESHOLD)
+		{
+			indices.swap(sortedIndices);
+			break;
+		}
+	}
+}
+
+void MeshOptimizer::OptimizeVertexCache(std::vector<uint32_t> &indices, size_t vertexCount, std::vector<size_t> &clusters)
+{
+	size_t triangleCount = indices.size() / 3;
+
+	// Triangles of every vertex, laid out one vertex after the other
+	std::vector<uint32_t> liveCounts(vertexCount, 0);
+	for (auto index : indices)
+	{
+		liveCounts[index]++;
+	}
+	std::vector<size_t> adjacencyOffsets(vertexCount + 1, 0);
+	for (size_t i = 0; i < vertexCount; i++)
+	{
+		adjacencyOffsets[i + 1] = adjacencyOffsets[i] + liveCounts[i];
+	}
+	std::vector<uint32_t> adjacency(indices.size());
+	std::vector<size_t> adjacencyFill(adjacencyOffsets.begin(), adjacencyOffsets.end() - 1);
+	for (size_t i = 0; i < indices.size(); i++)
+	{
+		adjacency[adjacencyFill[indices[i]]++] = (uint32_t)(i / 3);
+	}
+
+	std::vector<size_t> timestamps(vertexCount, 0);
+	std::vector<bool> isEmitted(triangleCount, false);
+	std::vector<uint32_t> deadEnds;
+	std::vector<uint32_t> candidates;
+	std::vector<uint32_t> output;
+	output.reserve(indices.size());
+
+	size_t time = VERTEX_CACHE_SIZE + 1;
+	size_t cursor = 0;
+	int fanningVertex = 0;
+	while (fanningVertex >= 0)
+	{
+		// Emit every remaining triangle around the fanning vertex
+		candidates.clear();
+		for (size_t i = adjacencyOffsets[fanningVertex]; i < adjacencyOffsets[fanningVertex + 1]; i++)
+		{
+			uint32_t triangle = adjacency[i];
+			if (isEmitted[triangle])
+				continue;
+			isEmitted[triangle] = true;
+			for (int corner = 0; corner < 3; corner++)
+			{
+				uint32_t vertex = indices[triangle * 3 + corner];
+				output.push_back(vertex);
+				deadEnds.push_back(vertex);
+				candidates.push_back(vertex);
+				liveCounts[vertex]--;
+				if (time - timestamps[vertex] > VERTEX_CACHE_SIZE)
+				{
+					timestamps[vertex] = time;
+					time++;
+				}
+			}
+		}
+
+		// Continue with the candidate furthest back in the cache that stays in it while its triangles are emitted
+		int nextVertex = -1;
+		int bestPriority = -1;
+		for (auto vertex : candidates)
+		{
+			if (liveCounts[vertex] == 0)
+				continue;
+			int priority = 0;
+			if (time - timestamps[vertex] + 2 * liveCounts[vertex] <= VERTEX_CACHE_SIZE)
+				priority = (int)(time - timestamps[vertex]);
+			if (priority > bestPriority)
+			{
+				bestPriority = priority;
+				nextVertex = vertex;
+			}
+		}
+		if (nextVertex >= 0)
+		{
+			fanningVertex = nextVertex;
+			continue;
+		}
+
+		// At a dead end take the most recent vertex with triangles left, else the next one in input order
+		// The triangles after a dead end start a new cluster
+		while (!deadEnds.empty() && nextVertex < 0)
+		{
+			uint32_t vertex = deadEnds.back();
+			deadEnds.pop_back();
+			if (liveCounts[vertex] > 0)
+				nextVertex = vertex;
+		}
+		while (cursor < vertexCount && nextVertex < 0)
+		{
+			if (liveCounts[cursor] > 0)
+				nextVertex = (int)cursor;
+			cursor++;
+		}
+		if (nextVertex >= 0)
+			clusters.push_back(output.size() / 3);
+		fanningVertex = nextVertex;
+	}
+
+	// The first cluster starts at the first triangle
+	clusters.insert(clusters.begin(), 0);
+	indices.swap(output);
+}
+
+size_t MeshOptimizer::CountCacheMisses(const uint32_t *indices, size_t indexCount, std::vector<size_t> &timestamps, size_t &time)
+{
+	// Moving the time past the cache size empties the cache without touching the timestamps
+	time += VERTEX_CACHE_SIZE + 1;
+	size_t misses = 0;
+	for (size_t i = 0; i < indexCount; i++)
+	{
+		if (time - timestamps[indices[i]] > VERTEX_CACHE_SIZE)
+		{
+			timestamps[indices[i]] = time;
+			time++;
+			misses++;
+		}
+	}
+	return misses;
+}
+
+void MeshOptimizer::SplitClusters(std::vector<uint32_t> &indices, size_t vertexCount, std::vector<size_t> &clusters)
+{
+	size_t triangleCount = indices.size() / 3;
+	std::vector<size_t> timestamps(vertexCount, 0);
+	size_t time = 0;
+	std::vector<size_t> splitClusters;
+
+	for (size_t cluster = 0; cluster < clusters.size(); cluster++)
+	{
+		size_t start = clusters[cluster];
+		size_t end = cluster + 1 < clusters.size() ? clusters[cluster + 1] : triangleCount;
+
+		// A piece of the cluster may be moved on its own once its miss ratio is close to that of the whole cluster
+		float clusterRatio = (float)CountCacheMisses(&indices[start * 3], (end - start) * 3, timestamps, time) / (end - start);
+		time += VERTEX_CACHE_SIZE + 1;
+		size_t pieceStart = start;
+		size_t pieceMisses = 0;
+		splitClusters.push_back(start);
+		for (size_t triangle = start; triangle < end; triangle++)
+		{
+			for (int corner = 0; corner < 3; corner++)
+			{
+				uint32_t vertex = indices[triangle * 3 + corner];
+				if (time - timestamps[vertex] > VERTEX_CACHE_SIZE)
+				{
+					timestamps[vertex] = time;
+					time++;
+					pieceMisses++;
+				}
+			}
+
+			if (triangle + 1 < end && (float)pieceMisses / (triangle + 1 - pieceStart) <= clusterRatio * OVERDRAW_THRESHOLD)
+			{
+				splitClusters.push_back(triangle + 1);
+				pieceStart = triangle + 1;
+				pieceMisses = 0;
+				time += VERTEX_CACHE_SIZE + 1;
+			}
+		}
+	}
+	clusters.swap(splitClusters);
+}
+
+void MeshOptimizer::OptimizeOverdraw(std::vector<uint32_t> &indices, const Vertex *vertices, std::vector<size_t> &clusters)
+{
+	size_t triangleCount = indices.size() / 3;
+
+	// Area weighted centroid and normal of every cluster and the centroid of the mesh
+	std::vector<Vec3> centroids(clusters.size());
+	std::vector<Vec3> normals(clusters.size());
+	Vec3 meshCentroid;
+	float meshArea = 0.0f;
+	for (size_t cluster = 0; cluster < clusters.size(); cluster++)
+	{
+		size_t end = cluster + 1 < clusters.size() ? clusters[cluster + 1] : triangleCount;
+		Vec3 centroid;
+		Vec3 normal;
+		float area = 0.0f;
+		for (size_t triangle = clusters[cluster]; triangle < end; triangle++)
+		{
+			Vec3 p0 = vertices[indices[triangle * 3]].position;
+			Vec3 p1 = vertices[indices[triangle * 3 + 1]].position;
+			Vec3 p2 = vertices[indices[triangle * 3 + 2]].position;
+			Vec3 e0 = p1 - p0;
+			Vec3 e1 = p2 - p0;
+			Vec3 cross = Vec3(e0.y * e1.z - e0.z * e1.y, e0.z * e1.x - e0.x * e1.z, e0.x * e1.y - e0.y * e1.x);
+			float triangleArea = (float)std::sqrt(cross * cross);
+			centroid = centroid + (p0 + p1 + p2) * (triangleArea / 3.0f);
+			normal = normal + cross;
+			area += triangleArea;
+		}
+		meshCentroid = meshCentroid + centroid;
+		meshArea += area;
+		centroids[cluster] = area > 0.0f ? centroid * (1.0f / area) : vertices[indices[clusters[cluster] * 3]].position;
+		float length = (float)std::sqrt(normal * normal);
+		normals[cluster] = length > 0.0f ? normal * (1.0f / length) : Vec3();
+	}
+	if (meshArea > 0.0f)
+		meshCentroid = meshCentroid * (1.0f / meshArea);
+
+	// Clusters facing away from the centre are the most likely to occlude the others, so they are drawn first
+	std::vector<float> sortKeys(clusters.size());
+	for (size_t cluster = 0; cluster < clusters.size(); cluster++)
+	{
+		Vec3 offset = centroids[cluster] - meshCentroid;
+		sortKeys[cluster] = (float)(offset * normals[cluster]);
+	}
+	std::vector<size_t> order(clusters.size());
+	std::iota(order.begin(), order.end(), 0);
+	std::stable_sort(order.begin(), order.end(), [&sortKeys](size_t a, size_t b) { return sortKeys[a] > sortKeys[b]; });
+
+	std::vector<uint32_t> output;
+	output.reserve(indices.size());
+	for (auto cluster : order)
+	{
+		size_t end = cluster + 1 < clusters.size() ? clusters[cluster + 1] : triangleCount;
+		output.insert(output.end(), indices.begin() + clusters[cluster] * 3, indices.begin() + end * 3);
+	}
+	indices.swap(output);
+}
+
+void MeshOptimizer::OptimizeVertexFetch(std::vector<Vertex> &vertices, std::vector<uint32_t> &indices)
+{
+	// Vertices no triangle uses are kept after the used ones
+	const uint32_t unused = UINT32_MAX;
+	std::vector<uint32_t> remap(vertices.size(), unused);
+	std::vector<Vertex> output;
+	output.reserve(vertices.size());
+	for (auto &index : indices)
+	{
+		if (remap[index] == unused)
+		{
+			remap[index] = (uint32_t)output.size();
+			output.push_back(vertices[index]);
+		}
+		index = remap[index];
+	}
+	for (size_t i = 0; i < vertices.size(); i++)
+	{
+		if (remap[i] == unused)
+			output.push_back(vertices[i]);
+	}
+	vertices.swap(output);
+}
+
+float MeshOptimizer::GetACMR(const uint32_t *indices, size_t indexCount, size_t vertexCount)
+{
+	if (indexCount < 3)
+		return 0.0f;
+	std::vector<size_t> timestamps(vertexCount, 0);
+	size_t time = 0;
+	return (float)CountCacheMisses(indices, indexCount, timestamps, time) / (indexCount / 3);
+}
@@ -0,0 +1,312 @@
+#include "MeshSimplifier.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <unordered_map>
+
+// Edge that can be collapsed by moving its first vertex onto the second
+struct Collapse
+{
+	uint32_t from;
+	uint32_t to;
+	double error;
+};
+
+void Quadric::AddPlane(Vec3 normal, float distance, float area)
+{
+	a00 += area * normal.x * normal.x;
+	a01 += area * normal.x * normal.y;
+	a02 += area * normal.x * normal.z;
+	a11 += area * normal.y * normal.y;
+	a12 += area * normal.y * normal.z;
+	a22 += area * normal.z * normal.z;
+	b0 += area * normal.x * distance;
+	b1 += area * normal.y * distance;
+	b2 += area * normal.z * distance;
+	c += area * distance * distance;
+	weight += area;
+}
+
+void Quadric::Add(Quadric &other)
+{
+	a00 += other.a00;
+	a01 += other.a01;
+	a02 += other.a02;
+	a11 += other.a11;
+	a12 += other.a12;
+	a22 += other.a22;
+	b0 += other.b0;
+	b1 += other.b1;
+	b2 += other.b2;
+	c += other.c;
+	weight += other.weight;
+}
+
+double Quadric::GetError(Vec3 p)
+{
+	if (weight <= 0.0)
+		return 0.0;
+	double error = a00 * p.x * p.x + a11 * p.y * p.y + a22 * p.z * p.z +
+		2.0 * (a01 * p.x * p.y + a02 * p.x * p.z + a12 * p.y * p.z) +
+		2.0 * (b0 * p.x + b1 * p.y + b2 * p.z) + c;
+	return std::max(error, 0.0) / weight;
+}
+
+// Function to get the unnormalized normal of a triangle
+static Vec3 GetTriangleNormal(Vec3 p0, Vec3 p1, Vec3 p2)
+{
+	Vec3 e0 = p1 - p0;
+	Vec3 e1 = p2 - p0;
+	return Vec3(e0.y * e1.z - e0.z * e1.y, e0.z * e1.x - e0.x * e1.z, e0.x * e1.y - e0.y * e1.x);
+}
+
+// Function to get the key of an edge independent of the order of its vertices
+static uint64_t GetEdgeKey(uint32_t a, uint32_t b)
+{
+	return a < b ? ((uint64_t)a << 32) | b : ((uint64_t)b << 32) | a;
+}
+
+float MeshSimplifier::Simplify(const Vertex *vertices, size_t vertexCount, const std::vector<uint32_t> &indices,
+	size_t targetIndexCount, float maxError, std::vector<uint32_t> &destination)
+{
+	destination = indices;
+
+	// Vertices sharing a position are the same point of the surface, each position is represented by its first vertex
+	std::vector<uint32_t> positionIds(vertexCount);
+	std::unordered_map<uint64_t, std::vector<uint32_t>> positionBuckets;
+	for (uint32_t i = 0; i < vertexCount; i++)
+	{
+		uint32_t bits[3];
+		memcpy(bits, &vertices[i].position, sizeof(bits));
+		uint64_t hash = ((uint64_t)bits[0] * 73856093u) ^ ((uint64_t)bits[1] * 19349663u) ^ ((uint64_t)bits[2] * 83492791u);
+		std::vector<uint32_t> &bucket = positionBuckets[hash];
+		positionIds[i] = i;
+		for (auto other : bucket)
+		{
+			if (memcmp(&vertices[other].position, &vertices[i].position, sizeof(bits)) == 0)
+			{
+				positionIds[i] = other;
+				break;
+			}
+		}
+		if (positionIds[i] == i)
+			bucket.push_back(i);
+	}
+
+	// A position used by more than one vertex lies on an attribute seam
+	std::vector<uint32_t> firstUser(vertexCount, UINT32_MAX);
+	std::vector<bool> isLocked(vertexCount, false);
+	for (auto index : indices)
+	{
+		uint32_t position = positionIds[index];
+		if (firstUser[position] == UINT32_MAX)
+			firstUser[position] = index;
+		else if (firstUser[position] != index)
+			isLocked[position] = true;
+	}
+
+	// Edges used by one triangle are on a border, edges used by more than two are non manifold
+	std::unordered_map<uint64_t, int> edgeUses;
+	for (size_t i = 0; i < indices.size(); i += 3)
+	{
+		for (int corner = 0; corner < 3; corner++)
+		{
+			edgeUses[GetEdgeKey(positionIds[indices[i + corner]], positionIds[indices[i + (corner + 1) % 3]])]++;
+		}
+	}
+	for (auto &edge : edgeUses)
+	{
+		if (edge.second != 2)
+		{
+			isLocked[(uint32_t)(edge.first >> 32)] = true;
+			isLocked[(uint32_t)(edge.first & 0xFFFFFFFF)] = true;
+		}
+	}
+
+	// Quadrics of the planes around every position
+	std::vector<Quadric> quadrics(vertexCount);
+	memset(quadrics.data(), 0, quadrics.size() * sizeof(Quadric));
+	for (size_t i = 0; i < indices.size(); i += 3)
+	{
+		Vec3 p0 = vertices[indices[i]].position;
+		Vec3 normal = GetTriangleNormal(p0, vertices[indices[i + 1]].position, vertices[indices[i + 2]].position);
+		float length = (float)std::sqrt(normal * normal);
+		if (length == 0.0f)
+			continue;
+		normal = normal * (1.0f / length);
+		float distance = -(float)(normal * p0);
+		for (int corner = 0; corner < 3; corner++)
+		{
+			quadrics[positionIds[indices[i + corner]]].AddPlane(normal, distance, length * 0.5f);
+		}
+	}
+
+	double errorLimit = (double)maxError * maxError;
+	double reachedError = 0.0;
+	std::vector<uint32_t> remap(vertexCount);
+	std::vector<bool> isTouched(vertexCount);
+	std::vector<size_t> adjacencyOffsets(vertexCount + 1);
+	std::vector<uint32_t> adjacency;
+	std::vector<Collapse> collapses;
+	std::vector<uint32_t> fromNeighbours;
+	std::vector<uint32_t> toNeighbours;
+
+	// Function to get the positions around a position, without the position and the other end of the edge
+	auto getNeighbours = [&](uint32_t center, uint32_t other, std::vector<uint32_t> &neighbours)
+	{
+		neighbours.clear();
+		for (size_t j = adjacencyOffsets[center]; j < adjacencyOffsets[center + 1]; j++)
+		{
+			for (int corner = 0; corner < 3; corner++)
+			{
+				uint32_t position = positionIds[destination[adjacency[j] * 3 + corner]];
+				if (position != center && position != other)
+					neighbours.push_back(position);
+			}
+		}
+		std::sort(neighbours.begin(), neighbours.end());
+		neighbours.erase(std::unique(neighbours.begin(), neighbours.end()), neighbours.end());
+	};
+
+	// Function to check that the ends of the edge share only the vertices opposite the edge,
+	// otherwise the collapse would fold the surface onto itself
+	auto isLinkKept = [&](Collapse &collapse, size_t collapsedTriangles)
+	{
+		getNeighbours(positionIds[collapse.from], positionIds[collapse.to], fromNeighbours);
+		getNeighbours(positionIds[collapse.to], positionIds[collapse.from], toNeighbours);
+		size_t sharedCount = 0;
+		size_t i = 0, j = 0;
+		while (i < fromNeighbours.size() && j < toNeighbours.size())
+		{
+			if (fromNeighbours[i] < toNeighbours[j])
+				i++;
+			else if (fromNeighbours[i] > toNeighbours[j])
+				j++;
+			else
+			{
+				sharedCount++;
+				i++;
+				j++;
+			}
+		}
+		return sharedCount == collapsedTriangles;
+	};
+
+	while (destination.size() > targetIndexCount)
+	{
+		// Triangles around every position
+		std::fill(adjacencyOffsets.begin(), adjacencyOffsets.end(), 0);
+		for (auto index : destination)
+		{
+			adjacencyOffsets[positionIds[index] + 1]++;
+		}
+		for (size_t i = 0; i < vertexCount; i++)
+		{
+			adjacencyOffsets[i + 1] += adjacencyOffsets[i];
+		}
+		adjacency.resize(destination.size());
+		std::vector<size_t> adjacencyFill(adjacencyOffsets.begin(), adjacencyOffsets.end() - 1);
+		for (size_t i = 0; i < destination.size(); i++)
+		{
+			adjacency[adjacencyFill[positionIds[destination[i]]]++] = (uint32_t)(i / 3);
+		}
+
+		// Cost of moving every free vertex onto each of its neighbours
+		collapses.clear();
+		for (size_t i = 0; i < destination.size(); i += 3)
+		{
+			for (int corner = 0; corner < 3; corner++)
+			{
+				uint32_t from = destination[i + corner];
+				uint32_t to = destination[i + (corner + 1) % 3];
+				for (int direction = 0; direction < 2; direction++)
+				{
+					if (!isLocked[positionIds[from]])
+					{
+						Quadric quadric = quadrics[positionIds[from]];
+						quadric.Add(quadrics[positionIds[to]]);
+						collapses.push_back({ from, to, quadric.GetError(vertices[to].position) });
+					}
+					std::swap(from, to);
+				}
+			}
+		}
+		std::sort(collapses.begin(), collapses.end(), [](const Collapse &a, const Collapse &b) { return a.error < b.error; });
+
+		// Collapse the cheapest edges, every position takes part in at most one collapse per pass
+		// A free vertex is the only vertex at its position, so its triangles are the triangles around the position
+		for (size_t i = 0; i < vertexCount; i++)
+		{
+			remap[i] = (uint32_t)i;
+		}
+		std::fill(isTouched.begin(), isTouched.end(), false);
+		size_t removedTriangles = 0;
+		size_t neededTriangles = (destination.size() - targetIndexCount + 2) / 3;
+		for (auto &collapse : collapses)
+		{
+			if (collapse.error > errorLimit || removedTriangles >= neededTriangles)
+				break;
+			if (isTouched[positionIds[collapse.from]] || isTouched[positionIds[collapse.to]])
+				continue;
+
+			// Reject the collapse if a remaining triangle around the vertex would flip over
+			Vec3 target = vertices[collapse.to].position;
+			bool isFlipped = false;
+			size_t collapsedTriangles = 0;
+			for (size_t j = adjacencyOffsets[positionIds[collapse.from]]; j < adjacencyOffsets[positionIds[collapse.from] + 1] && !isFlipped; j++)
+			{
+				const uint32_t *triangle = &destination[adjacency[j] * 3];
+				bool hasTarget = false;
+				Vec3 positions[3];
+				Vec3 movedPositions[3];
+				for (int corner = 0; corner < 3; corner++)
+				{
+					hasTarget = hasTarget || positionIds[triangle[corner]] == positionIds[collapse.to];
+					positions[corner] = vertices[triangle[corner]].position;
+					movedPositions[corner] = triangle[corner] == collapse.from ? target : positions[corner];
+				}
+				if (hasTarget)
+				{
+					collapsedTriangles++;
+					continue;
+				}
+				Vec3 normal = GetTriangleNormal(positions[0], positions[1], positions[2]);
+				Vec3 movedNormal = GetTriangleNormal(movedPositions[0], movedPositions[1], movedPositions[2]);
+				isFlipped = normal * movedNormal <= 0.0;
+			}
+			if (isFlipped || !isLinkKept(collapse, collapsedTriangles))
+				continue;
+
+			// The positions around the collapsed one change shape, so they wait for the next pass
+			for (size_t j = adjacencyOffsets[positionIds[collapse.from]]; j < adjacencyOffsets[positionIds[collapse.from] + 1]; j++)
+			{
+				for (int corner = 0; corner < 3; corner++)
+				{
+					isTouched[positionIds[destination[adjacency[j] * 3 + corner]]] = true;
+				}
+			}
+			remap[collapse.from] = collapse.to;
+			quadrics[positionIds[collapse.to]].Add(quadrics[positionIds[collapse.from]]);
+			removedTriangles += collapsedTriangles;
+			reachedError = std::max(reachedError, collapse.error);
+		}
+		if (removedTriangles == 0)
+			break;
+
+		// Drop the triangles that lost an edge
+		size_t writeIndex = 0;
+		for (size_t i = 0; i < destination.size(); i += 3)
+		{
+			uint32_t a = remap[destination[i]];
+			uint32_t b = remap[destination[i + 1]];
+			uint32_t c = remap[destination[i + 2]];
+			if (positionIds[a] == positionIds[b] || positionIds[b] == positionIds[c] || positionIds[a] == positionIds[c])
+				continue;
+			destination[writeIndex++] = a;
+			destination[writeIndex++] = b;
+			destination[writeIndex++] = c;
+		}
+		destination.resize(writeIndex);
+	}
+	return (float)std::sqrt(reachedError);
+}
@@ -0,0 +1,592 @@
+#include "ObjReader.h"
+#include <algorithm>
+#include <charconv>
+#include <cstdint>
+#include <cstring>
+#include <exception>
+#include <stdexcept>
+#include <thread>
+#include <utility>
+
+// Function to check whether a character separates the tokens of a line
+static bool IsSpace(char character)
+{
+	return character == ' ' || character == '\t';
+}
+
+// Function to check whether the line at the cursor starts with the keyword followed by a space
+static bool HasKeyword(const char *cursor, const char *end, const char *keyword, size_t length)
+{
+	return (size_t)(end - cursor) > length && memcmp(cursor, keyword, length) == 0 && IsSpace(cursor[length]);
+}
+
+// Powers of ten that are exact in a float
+static const float exactPowersOfTen[] = { 1e0f, 1e1f, 1e2f, 1e3f, 1e4f, 1e5f, 1e6f, 1e7f, 1e8f, 1e9f, 1e10f };
+
+// Function to read a plain decimal like -12.345 whose digits fit in the mantissa of a float
+// The digits and the power of ten are both exact, so the single division rounds exactly like from_chars
+// Returns false without moving the cursor for anything else, which is left to from_chars
+static bool ReadExactDecimal(const char *&cursor, const char *end, float &value)
+{
+	const char *character = cursor;
+	bool isNegative = character < end && *character == '-';
+	if (isNegative)
+		character++;
+
+	uint32_t digits = 0;
+	int digitCount = 0;
+	int fractionCount = 0;
+	bool hasPoint = false;
+	for (; character < end; character++)
+	{
+		if (*character >= '0' && *character <= '9')
+		{
+			// Leading zeros do not count against the mantissa
+			if (digits != 0 || *character != '0')
+				digitCount++;
+			if (digitCount > 8)
+				return false;
+			digits = digits * 10 + (*character - '0');
+			fractionCount += hasPoint;
+		}
+		else if (*character == '.' && !hasPoint)
+			hasPoint = true;
+		else
+			break;
+	}
+
+	// Exponents, infinities and anything unusual take the slow path
+	bool hasDigits = character - cursor > (isNegative ? 1 : 0) + (hasPoint ? 1 : 0);
+	if (!hasDigits || digits > (1u << 24) || fractionCount > 10 ||
+		(character < end && (*character == 'e' || *character == 'E' || *character == 'n' || *character == 'i')))
+		return false;
+
+	value = (float)digits / exactPowersOfTen[fractionCount];
+	if (isNegative)
+		value = -value;
+	cursor = character;
+	return true;
+}
+
+ObjChunk::ObjChunk(const char *begin, const char *end)
+{
+	this->begin = begin;
+	this->cursor = begin;
+	this->end = end;
+	positionOffset = 0;
+	normalOffset = 0;
+	texCoordOffset = 0;
+	indexOffset = 0;
+}
+
+ObjCounts ObjChunk::CountElements()
+{
+	ObjCounts counts = {};
+	const char *line = begin;
+	while (line < end)
+	{
+		const char *lineEnd = (const char*)memchr(line, '\n', end - line);
+		if (lineEnd == nullptr)
+			lineEnd = end;
+
+		if (HasKeyword(line, lineEnd, "v", 1))
+			counts.positionCount++;
+		else if (HasKeyword(line, lineEnd, "vn", 2))
+			counts.normalCount++;
+		else if (HasKeyword(line, lineEnd, "vt", 2))
+			counts.texCoordCount++;
+		else if (HasKeyword(line, lineEnd, "f", 1))
+		{
+			// Every corner follows at least one space, so counting the spaces gives an upper bound without branching
+			size_t cornerCount = std::count(line + 1, lineEnd, ' ') + std::count(line + 1, lineEnd, '\t');
+			counts.faceCount++;
+			counts.cornerCount += cornerCount;
+			counts.triangleCount += cornerCount >= 3 ? cornerCount - 2 : 0;
+		}
+		line = lineEnd + 1;
+	}
+	return counts;
+}
+
+void ObjChunk::SkipSpaces()
+{
+	while (cursor < end && IsSpace(*cursor))
+		cursor++;
+}
+
+void ObjChunk::SkipLine()
+{
+	const char *lineEnd = (const char*)memchr(cursor, '\n', end - cursor);
+	cursor = lineEnd != nullptr ? lineEnd + 1 : end;
+}
+
+bool ObjChunk::IsLineEnd()
+{
+	return cursor >= end || *cursor == '\n' || *cursor == '\r' || *cursor == '#';
+}
+
+std::string ObjChunk::ReadRestOfLine()
+{
+	SkipSpaces();
+	const char *start = cursor;
+	while (!IsLineEnd())
+		cursor++;
+	const char *stop = cursor;
+	while (stop > start && IsSpace(stop[-1]))
+		stop--;
+	return std::string(start, stop);
+}
+
+float ObjChunk::ReadFloat()
+{
+	SkipSpaces();
+	if (IsLineEnd())
+		return 0.0f;
+
+	// from_chars does not accept a leading plus sign
+	if (*cursor == '+')
+		cursor++;
+	float value = 0.0f;
+	if (ReadExactDecimal(cursor, end, value))
+		return value;
+	std::from_chars_result result = std::from_chars(cursor, end, value);
+	if (result.ec != std::errc())
+	{
+		throw std::runtime_error("obj file has an invalid number!");
+	}
+	cursor = result.ptr;
+	return value;
+}
+
+// Missing components of a vector are left at zero
+Vec3 ObjChunk::ReadVector()
+{
+	Vec3 vector;
+	vector.x = ReadFloat();
+	vector.y = ReadFloat();
+	vector.z = ReadFloat();
+	return vector;
+}
+
+bool ObjChunk::ReadIndex(int &index)
+{
+	std::from_chars_result result = std::from_chars(cursor, end, index);
+	if (result.ec != std::errc())
+		return false;
+	cursor = result.ptr;
+	return true;
+}
+
+int ObjChunk::GetCornerIndex(int index, size_t localCount, int component)
+{
+	if (index == 0)
+	{
+		throw std::runtime_error("obj file has a face index out of range!");
+	}
+	if (index > 0)
+		return index - 1;
+
+	// Relative indices count back from the elements read so far, which the earlier chunks add to
+	ObjIndexFixup fixup = { (int)corners.size(), component };
+	fixups.push_back(fixup);
+	return (int)localCount + index;
+}
+
+void ObjChunk::ReadFace()
+{
+	int firstCorner = corners.size();
+	int cornerCount = 0;
+	while (true)
+	{
+		SkipSpaces();
+		if (IsLineEnd())
+			break;
+
+		// Corners are given as position, position/tex, position//normal or position/tex/normal
+		int positionIndex, texIndex, normalIndex;
+		if (!ReadIndex(positionIndex))
+		{
+			throw std::runtime_error("obj file has an invalid face!");
+		}
+		bool hasTex = false;
+		bool hasNormal = false;
+		if (cursor < end && *cursor == '/')
+		{
+			cursor++;
+			hasTex = ReadIndex(texIndex);
+			if (cursor < end && *cursor == '/')
+			{
+				cursor++;
+				hasNormal = ReadIndex(normalIndex);
+			}
+		}
+
+		ObjCorner corner;
+		corner.position = GetCornerIndex(positionIndex, positions.size(), 0);
+		corner.tex = hasTex ? GetCornerIndex(texIndex, texCoords.size(), 1) : -1;
+		corner.normal = hasNormal ? GetCornerIndex(normalIndex, normals.size(), 2) : -1;
+		corners.push_back(corner);
+
+		// Every corner after the second closes a triangle with the first corner and the previous one
+		cornerCount++;
+		if (cornerCount >= 3)
+		{
+			int corner_index = corners.size();
+			triangleCorners.push_back(firstCorner);
+			triangleCorners.push_back(corner_index - 2);
+			triangleCorners.push_back(corner_index - 1);
+		}
+	}
+}
+
+void ObjChunk::Parse()
+{
+	ObjCounts counts = CountElements();
+	positions.reserve(counts.positionCount);
+	normals.reserve(counts.normalCount);
+	texCoords.reserve(counts.texCoordCount);
+	corners.reserve(counts.cornerCount);
+	triangleCorners.reserve(3 * counts.triangleCount);
+
+	cursor = begin;
+	while (cursor < end)
+	{
+		SkipSpaces();
+		if (HasKeyword(cursor, end, "v", 1))
+		{
+			cursor += 1;
+			positions.push_back(ReadVector());
+		}
+		else if (HasKeyword(cursor, end, "vn", 2))
+		{
+			cursor += 2;
+			normals.push_back(ReadVector());
+		}
+		else if (HasKeyword(cursor, end, "vt", 2))
+		{
+			cursor += 2;
+			Vec3 v = ReadVector();
+			v.y = 1 - v.y;
+			texCoords.push_back(v);
+		}
+		else if (HasKeyword(cursor, end, "f", 1))
+		{
+			cursor += 1;
+			ReadFace();
+		}
+		else if (HasKeyword(cursor, end, "mtllib", 6) && materialFilename.empty())
+		{
+			cursor += 6;
+			materialFilename = ReadRestOfLine();
+		}
+		SkipLine();
+	}
+}
+
+// Function to check an index against the number of elements of the file, missing indices pass
+static void CheckIndex(int index, size_t count)
+{
+	if (index < -1 || (index >= 0 && (size_t)index >= count))
+	{
+		throw std::runtime_error("obj file has a face index out of range!");
+	}
+}
+
+void ObjChunk::Resolve(size_t positionCount, size_t texCoordCount, size_t normalCount)
+{
+	size_t offsets[3] = { positionOffset, texCoordOffset, normalOffset };
+	for (auto fixup : fixups)
+	{
+		// A relative index reaching before the start of the file must not be taken for a missing one
+		int *component = &corners[fixup.corner].position + fixup.component;
+		*component += (int)offsets[fixup.component];
+		if (*component < 0)
+		{
+			throw std::runtime_error("obj file has a face index out of range!");
+		}
+	}
+
+	for (auto &corner : corners)
+	{
+		CheckIndex(corner.position, positionCount);
+		CheckIndex(corner.tex, texCoordCount);
+		CheckIndex(corner.normal, normalCount);
+		if (corner.position == -1)
+		{
+			throw std::runtime_error("obj file has a face index out of range!");
+		}
+	}
+
+	// Missing indices are stored as -1, which no present index can equal
+	std::unordered_map<ObjCorner, int, ObjCornerHash> cornerVertices;
+	cornerVertices.reserve(std::min(corners.size(), std::max(positions.size(), texCoords.size())));
+	std::vector<int> vertexOfCorner(corners.size());
+	for (size_t i = 0; i < corners.size(); i++)
+	{
+		ObjCorner &corner = corners[i];
+		auto inserted = cornerVertices.emplace(corner, (int)vertexCorners.size());
+		if (inserted.second)
+		{
+			vertexCorners.push_back(corner);
+		}
+		vertexOfCorner[i] = inserted.first->second;
+	}
+
+	indices.resize(triangleCorners.size());
+	for (size_t i = 0; i < triangleCorners.size(); i++)
+	{
+		indices[i] = vertexOfCorner[triangleCorners[i]];
+	}
+
+	// The corners are not needed past this point
+	std::vector<ObjCorner>().swap(corners);
+	std::vector<int>().swap(triangleCorners);
+}
+
+ObjReader::ObjReader(const char *data, size_t size)
+{
+	begin = data;
+	end = data + size;
+}
+
+void ObjReader::SplitChunks(int threadCount)
+{
+	size_t size = end - begin;
+	size_t chunkCount = std::max((size_t)1, std::min((size_t)threadCount, size / OBJ_MIN_CHUNK_SIZE));
+
+	// Every chunk ends after a line break, so no line is split between two chunks
+	chunks.clear();
+	const char *chunkBegin = begin;
+	for (size_t i = 1; i <= chunkCount && chunkBegin < end; i++)
+	{
+		const char *chunkEnd = i == chunkCount ? end : begin + size * i / chunkCount;
+		if (chunkEnd < chunkBegin)
+			chunkEnd = chunkBegin;
+		const char *lineEnd = (const char*)memchr(chunkEnd, '\n', end - chunkEnd);
+		chunkEnd = lineEnd != nullptr && i != chunkCount ? lineEnd + 1 : end;
+		chunks.push_back(ObjChunk(chunkBegin, chunkEnd));
+		chunkBegin = chunkEnd;
+	}
+}
+
+ObjChunkPool::ObjChunkPool(int threadCount)
+{
+	isStopping = false;
+	for (int i = 0; i < threadCount; i++)
+	{
+		threads.push_back(std::thread(&ObjChunkPool::WorkerLoop, this));
+	}
+}
+
+ObjChunkPool::~ObjChunkPool()
+{
+	{
+		std::lock_guard<std::mutex> lock(tasksMutex);
+		isStopping = true;
+	}
+	tasksCondition.notify_all();
+	for (auto &thread : threads)
+	{
+		thread.join();
+	}
+}
+
+ObjChunkPool * ObjChunkPool::GetInstance()
+{
+	// The thread of the reader runs a chunk as well, so the pool leaves it a hardware thread
+	static ObjChunkPool pool((int)std::max(1u, std::thread::hardware_concurrency()) - 1);
+	return &pool;
+}
+
+void ObjChunkPool::Push(std::function<void()> task)
+{
+	{
+		std::lock_guard<std::mutex> lock(tasksMutex);
+		tasks.push_back(std::move(task));
+	}
+	tasksCondition.notify_one();
+}
+
+void ObjChunkPool::RunTask(std::unique_lock<std::mutex> &lock)
+{
+	std::function<void()> task = std::move(tasks.front());
+	tasks.pop_front();
+	lock.unlock();
+	task();
+	lock.lock();
+	tasksCondition.notify_all();
+}
+
+void ObjChunkPool::WorkerLoop()
+{
+	std::unique_lock<std::mutex> lock(tasksMutex);
+	while (true)
+	{
+		tasksCondition.wait(lock, [this]() { return isStopping || !tasks.empty(); });
+		if (tasks.empty())
+			return;
+		RunTask(lock);
+	}
+}
+
+void ObjChunkPool::RunUntilDone(std::atomic<size_t> &pendingCount)
+{
+	// Tasks lower the count before the lock is taken to wake the waiting readers, so no wake up is lost
+	std::unique_lock<std::mutex> lock(tasksMutex);
+	while (pendingCount > 0)
+	{
+		if (!tasks.empty())
+			RunTask(lock);
+		else
+			tasksCondition.wait(lock);
+	}
+}
+
+template <typename Step>
+void ObjReader::RunChunks(Step step)
+{
+	// The first chunk runs on the calling thread, which then helps with the queued chunks until its own are done
+	// Errors of the chunks are raised once all of them are done
+	ObjChunkPool *pool = ObjChunkPool::GetInstance();
+	std::vector<std::exception_ptr> errors(chunks.size());
+	auto runChunk = [this, &step, &errors](size_t i)
+	{
+		try
+		{
+			step(chunks[i]);
+		}
+		catch (...)
+		{
+			errors[i] = std::current_exception();
+		}
+	};
+
+	std::atomic<size_t> pendingCount(chunks.size() - 1);
+	for (size_t i = 1; i < chunks.size(); i++)
+	{
+		pool->Push([&runChunk, &pendingCount, i]()
+			{
+				runChunk(i);
+				pendingCount--;
+			});
+	}
+	runChunk(0);
+	pool->RunUntilDone(pendingCount);
+
+	for (auto &error : errors)
+	{
+		if (error != nullptr)
+			std::rethrow_exception(error);
+	}
+}
+
+void ObjReader::Parse(std::vector<Vertex> &vertices, std::vector<uint32_t> &indices, int threadCount)
+{
+	if (threadCount <= 0)
+		threadCount = std::max(1u, std::thread::hardware_concurrency());
+	SplitChunks(threadCount);
+	if (chunks.empty())
+		return;
+
+	RunChunks([](ObjChunk &chunk)
+		{
+			chunk.Parse();
+		});
+
+	// Prefix sums of the elements give the offsets of every chunk into the arrays of the file
+	size_t positionCount = 0;
+	size_t normalCount = 0;
+	size_t texCoordCount = 0;
+	for (auto &chunk : chunks)
+	{
+		chunk.positionOffset = positionCount;
+		chunk.normalOffset = normalCount;
+		chunk.texCoordOffset = texCoordCount;
+		positionCount += chunk.positions.size();
+		normalCount += chunk.normals.size();
+		texCoordCount += chunk.texCoords.size();
+		if (materialFilename.empty())
+			materialFilename = chunk.materialFilename;
+	}
+	positions.resize(positionCount);
+	normals.resize(normalCount);
+	texCoords.resize(texCoordCount);
+
+	RunChunks([this, positionCount, texCoordCount, normalCount](ObjChunk &chunk)
+		{
+			std::copy(chunk.positions.begin(), chunk.positions.end(), positions.begin() + chunk.positionOffset);
+			std::copy(chunk.normals.begin(), chunk.normals.end(), normals.begin() + chunk.normalOffset);
+			std::copy(chunk.texCoords.begin(), chunk.texCoords.end(), texCoords.begin() + chunk.texCoordOffset);
+			chunk.Resolve(positionCount, texCoordCount, normalCount);
+		});
+
+	// Merge the distinct corners of the chunks in order, so the vertices come out in order of first use as in a single pass
+	size_t vertexEstimate = 0;
+	size_t indexCount = 0;
+	for (auto &chunk : chunks)
+	{
+		chunk.indexOffset = indices.size() + indexCount;
+		vertexEstimate += chunk.vertexCorners.size();
+		indexCount += chunk.indices.size();
+	}
+	std::unordered_map<ObjCorner, uint32_t, ObjCornerHash> cornerVertices;
+	vertices.reserve(vertices.size() + vertexEstimate);
+	indices.resize(indices.size() + indexCount);
+
+	// The corners of a single chunk are distinct already, so they are taken in order without the map
+	bool isSingleChunk = chunks.size() == 1;
+	if (!isSingleChunk)
+		cornerVertices.reserve(vertexEstimate);
+
+	uint32_t firstVertex = vertices.size();
+	std::vector<std::vector<uint32_t>> chunkVertices(chunks.size());
+	for (size_t i = 0; i < chunks.size(); i++)
+	{
+		ObjChunk &chunk = chunks[i];
+		chunkVertices[i].resize(chunk.vertexCorners.size());
+		for (size_t j = 0; j < chunk.vertexCorners.size(); j++)
+		{
+			std::pair<uint32_t, bool> vertex(firstVertex + (uint32_t)j, true);
+			if (!isSingleChunk)
+			{
+				auto inserted = cornerVertices.emplace(chunk.vertexCorners[j], (uint32_t)vertices.size());
+				vertex = std::make_pair(inserted.first->second, inserted.second);
+			}
+			if (vertex.second)
+			{
+				ObjCorner &corner = chunk.vertexCorners[j];
+				Vertex v;
+				v.position = positions[corner.position];
+				Vec3 color;
+				color.x = 1.0f;
+				color.y = 1.0f;
+				color.z = 1.0f;
+				v.color = color;
+				v.tex = corner.tex != -1 ? texCoords[corner.tex] : Vec3();
+				v.normal = corner.normal != -1 ? normals[corner.normal] : Vec3();
+				vertices.push_back(v);
+			}
+			chunkVertices[i][j] = vertex.first;
+		}
+	}
+
+	RunChunks([this, &indices, &chunkVertices](ObjChunk &chunk)
+		{
+			std::vector<uint32_t> &remap = chunkVertices[&chunk - chunks.data()];
+			for (size_t j = 0; j < chunk.indices.size(); j++)
+			{
+				indices[chunk.indexOffset + j] = remap[chunk.indices[j]];
+			}
+		});
+	chunks.clear();
+}
+
+std::string ObjReader::GetMaterialFilename()
+{
+	return materialFilename;
+}
+
+std::vector<Vec3> & ObjReader::GetPositions()
+{
+	return positions;
+}
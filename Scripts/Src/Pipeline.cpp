@@ -15,7 +15,7 @@ void Pipeline::CreatePipeline(Device *device, Swapchain *swapChain, VkRenderPass
 	if (!isComputePipeline)
 	{
 		// Information of format of the vertex data passed to the vertex shader
-		CreateVertexInputInfo();
+		CreateVertexInputInfo(additionalParams.InputVertexFormat);
 
 		CreateInputAssemblyInfo(VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST);
 
@@ -106,13 +106,13 @@ void Pipeline::CreateShaderStages(std::unordered_map<VkShaderStageFlagBits,std::
 	}
 }
 
-void Pipeline::CreateVertexInputInfo()
+void Pipeline::CreateVertexInputInfo(VertexFormat vertexFormat)
 {
 	// Binding description
-	bindingDescription = BindingAttributeDescriptionHelper::getBindingDescription();
+	bindingDescription = BindingAttributeDescriptionHelper::getBindingDescription(vertexFormat);
 
 	// Attribute description
-	attributeDescriptions = BindingAttributeDescriptionHelper::getAttributeDescriptions();
+	attributeDescriptions = BindingAttributeDescriptionHelper::getAttributeDescriptions(vertexFormat);
 
 	// Information of format of the vertex data passed to the vertex shader
 	vertexInputInfo = {};
@@ -6,6 +6,9 @@
 UIParameters UIDesign::uiParams = {
 0.75,			   // scale
 true,			   // scale
+0.0,			   // collision budget in microseconds, zero for no budget
+4000.0,			   // upload budget per frame in microseconds
+1.0,			   // largest error of a level of detail on screen in pixels
 false			   // scale
 };
 
@@ -15,6 +18,9 @@ void UIDesign::DrawUI()
 
 	ImGui::SliderFloat("Scale", &uiParams.scale, 0.1, 50.0);
 	ImGui::Checkbox("Collision Enabled", &uiParams.isCollisionEnabled);
+	ImGui::SliderFloat("Collision Budget (us)", &uiParams.collisionBudget, 0.0, 10000.0);
+	ImGui::SliderFloat("Upload Budget (us)", &uiParams.uploadBudget, 0.0, 16000.0);
+	ImGui::SliderFloat("LOD Error (px)", &uiParams.lodPixelError, 0.0, 20.0);
 	ImGui::Checkbox("Show Octree/AABB", &uiParams.renderAABB);
 
 	ImGui::Text("Application average %.3f ms/frame (%.1f FPS)", 1000.0f / ImGui::GetIO().Framerate, ImGui::GetIO().Framerate);
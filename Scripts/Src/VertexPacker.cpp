@@ -0,0 +1,157 @@
+#include "VertexPacker.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+int16_t VertexPacker::EncodeSnorm16(float value)
+{
+	value = std::max(-1.0f, std::min(1.0f, value));
+	return (int16_t)std::lround(value * 32767.0f);
+}
+
+uint16_t VertexPacker::EncodeHalf(float value)
+{
+	uint32_t bits;
+	memcpy(&bits, &value, sizeof(bits));
+	uint16_t sign = (uint16_t)((bits >> 16) & 0x8000);
+	uint32_t exponent = (bits >> 23) & 0xFF;
+	uint32_t mantissa = bits & 0x7FFFFF;
+
+	// Infinity and NaN, NaN keeps a mantissa bit
+	if (exponent == 0xFF)
+		return sign | 0x7C00 | (mantissa != 0 ? 0x200 : 0);
+
+	int halfExponent = (int)exponent - 127 + 15;
+
+	// Too large for a half float
+	if (halfExponent >= 0x1F)
+		return sign | 0x7C00;
+
+	// Subnormal half float or zero, the implicit bit is shifted into the mantissa
+	if (halfExponent <= 0)
+	{
+		if (halfExponent < -10)
+			return sign;
+		mantissa |= 0x800000;
+		int shift = 14 - halfExponent;
+		uint32_t halfMantissa = mantissa >> shift;
+		uint32_t remainder = mantissa & ((1u << shift) - 1);
+		uint32_t halfway = 1u << (shift - 1);
+		if (remainder > halfway || (remainder == halfway && (halfMantissa & 1)))
+			halfMantissa++;
+		return sign | (uint16_t)halfMantissa;
+	}
+
+	// Round the mantissa to nearest even, a carry moves into the exponent
+	uint32_t half = ((uint32_t)halfExponent << 10) | (mantissa >> 13);
+	uint32_t remainder = mantissa & 0x1FFF;
+	if (remainder > 0x1000 || (remainder == 0x1000 && (half & 1)))
+		half++;
+	return sign | (uint16_t)half;
+}
+
+void VertexPacker::EncodeOctahedral(Vec3 normal, int16_t encoded[2])
+{
+	// Project onto the octahedron, missing normals are stored as the zero vector which decodes to +Z
+	float length = std::fabs(normal.x) + std::fabs(normal.y) + std::fabs(normal.z);
+	if (length == 0.0f)
+	{
+		encoded[0] = 0;
+		encoded[1] = 0;
+		return;
+	}
+	float x = normal.x / length;
+	float y = normal.y / length;
+
+	// Fold the lower hemisphere over the diagonals
+	if (normal.z < 0.0f)
+	{
+		float foldedX = (1.0f - std::fabs(y)) * (x >= 0.0f ? 1.0f : -1.0f);
+		float foldedY = (1.0f - std::fabs(x)) * (y >= 0.0f ? 1.0f : -1.0f);
+		x = foldedX;
+		y = foldedY;
+	}
+	encoded[0] = EncodeSnorm16(x);
+	encoded[1] = EncodeSnorm16(y);
+}
+
+size_t VertexPacker::GetVertexSize(VertexFormat format)
+{
+	switch (format)
+	{
+	case VERTEX_FORMAT_PACKED:
+		return sizeof(PackedVertex);
+	case VERTEX_FORMAT_QUANTIZED:
+		return sizeof(QuantizedVertex);
+	default:
+		return sizeof(Vertex);
+	}
+}
+
+VertexDequantization VertexPacker::PackVertices(const Vertex *vertices, size_t vertexCount, VertexFormat format,
+	Vec3 minPosition, Vec3 maxPosition, std::vector<uint8_t> &packedVertices)
+{
+	VertexDequantization dequantization;
+	dequantization.scale = Vec3(1.0f, 1.0f, 1.0f);
+	dequantization.offset = Vec3();
+
+	packedVertices.resize(vertexCount * GetVertexSize(format));
+	if (format == VERTEX_FORMAT_FULL)
+	{
+		memcpy(packedVertices.data(), vertices, packedVertices.size());
+		return dequantization;
+	}
+
+	if (format == VERTEX_FORMAT_PACKED)
+	{
+		PackedVertex *packed = (PackedVertex*)packedVertices.data();
+		for (size_t i = 0; i < vertexCount; i++)
+		{
+			packed[i].position[0] = vertices[i].position.x;
+			packed[i].position[1] = vertices[i].position.y;
+			packed[i].position[2] = vertices[i].position.z;
+			EncodeOctahedral(vertices[i].normal, packed[i].normal);
+			packed[i].tex[0] = EncodeHalf(vertices[i].tex.x);
+			packed[i].tex[1] = EncodeHalf(vertices[i].tex.y);
+		}
+		return dequantization;
+	}
+
+	// Map the bounds onto [-1, 1], a flat axis keeps a unit scale and stores zero
+	dequantization.offset = Vec3((minPosition.x + maxPosition.x) * 0.5f, (minPosition.y + maxPosition.y) * 0.5f,
+		(minPosition.z + maxPosition.z) * 0.5f);
+	dequantization.scale = Vec3((maxPosition.x - minPosition.x) * 0.5f, (maxPosition.y - minPosition.y) * 0.5f,
+		(maxPosition.z - minPosition.z) * 0.5f);
+	float *scale[3] = { &dequantization.scale.x, &dequantization.scale.y, &dequantization.scale.z };
+	for (int axis = 0; axis < 3; axis++)
+	{
+		if (*scale[axis] <= 0.0f)
+			*scale[axis] = 1.0f;
+	}
+
+	QuantizedVertex *quantized = (QuantizedVertex*)packedVertices.data();
+	for (size_t i = 0; i < vertexCount; i++)
+	{
+		Vec3 position = vertices[i].position;
+		quantized[i].position[0] = EncodeSnorm16((position.x - dequantization.offset.x) / dequantization.scale.x);
+		quantized[i].position[1] = EncodeSnorm16((position.y - dequantization.offset.y) / dequantization.scale.y);
+		quantized[i].position[2] = EncodeSnorm16((position.z - dequantization.offset.z) / dequantization.scale.z);
+		quantized[i].position[3] = 0;
+		EncodeOctahedral(vertices[i].normal, quantized[i].normal);
+		quantized[i].tex[0] = EncodeHalf(vertices[i].tex.x);
+		quantized[i].tex[1] = EncodeHalf(vertices[i].tex.y);
+	}
+	return dequantization;
+}
+
+void VertexPacker::GetBounds(const Vertex *vertices, size_t vertexCount, Vec3 &minPosition, Vec3 &maxPosition)
+{
+	minPosition = vertexCount > 0 ? vertices[0].position : Vec3();
+	maxPosition = minPosition;
+	for (size_t i = 1; i < vertexCount; i++)
+	{
+		Vec3 position = vertices[i].position;
+		minPosition = Vec3(std::min(minPosition.x, position.x), std::min(minPosition.y, position.y), std::min(minPosition.z, position.z));
+		maxPosition = Vec3(std::max(maxPosition.x, position.x), std::max(maxPosition.y, position.y), std::max(maxPosition.z, position.z));
+	}
+}
@@ -1,4 +1,5 @@
 D:\softwares\VulkanSDK\1.1.130.0\Bin32\glslc.exe shader.vert -o vert.spv
+D:\softwares\VulkanSDK\1.1.130.0\Bin32\glslc.exe packed.vert -o packed_vert.spv
 D:\softwares\VulkanSDK\1.1.130.0\Bin32\glslc.exe shader.frag -o frag.spv
 D:\softwares\VulkanSDK\1.1.130.0\Bin32\glslc.exe shader.geom -o geom.spv
 D:\softwares\VulkanSDK\1.1.130.0\Bin32\glslc.exe shader.comp -o Comp.spv
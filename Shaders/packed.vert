@@ -0,0 +1,65 @@
+#version 450
+#extension GL_ARB_separate_shader_objects : enable
+
+// Uniform for Model, View and Projection matrices
+// Stored positions are turned back into model positions with the scale and offset
+layout(binding = 0) uniform UniformBufferObject {
+    mat4 model;
+    mat4 view;
+    mat4 proj;
+    vec4 positionScale;
+    vec4 positionOffset;
+} ubo;
+
+// Uniform for Lighting Properties
+layout(binding = 1) uniform LightingConstants {
+	float isCollided;
+	float useOpacityMap;
+	float showAABB;
+} lighting;
+
+// Input values at a packed vertex, the colour is not stored
+layout(location = 0) in vec3 inPosition;
+layout(location = 2) in vec2 inTexCoord;
+layout(location = 3) in vec2 inNormal;
+
+// Output values to fragment shader
+layout(location = 0) out vec3 fragColor;
+layout(location = 1) out vec2 fragTexCoord;
+layout(location = 2) out vec4 fragNormal;
+layout(location = 3) out float isCollided;
+layout(location = 4) out float useOpacityMap;
+layout(location = 5) out float showAABB;
+
+// Function to decode an octahedral encoded normal
+vec3 decodeOctahedral(vec2 encoded)
+{
+	vec3 normal = vec3(encoded, 1.0 - abs(encoded.x) - abs(encoded.y));
+	float fold = max(-normal.z, 0.0);
+	normal.x += normal.x >= 0.0 ? -fold : fold;
+	normal.y += normal.y >= 0.0 ? -fold : fold;
+	return normalize(normal);
+}
+
+// Main function
+void main() {
+
+	// Calculate vertex position
+	vec3 position = inPosition * ubo.positionScale.xyz + ubo.positionOffset.xyz;
+	vec4 VCS_position =  ubo.view * ubo.model * vec4(position, 1.0);
+    gl_Position = ubo.proj *VCS_position;
+
+	// Packed vertices are always white
+    fragColor = vec3(1.0);
+
+	// Pass Texture Coordinates
+    fragTexCoord = inTexCoord;
+
+	// Calculate and pass normal
+	fragNormal = ubo.view * ubo.model * vec4(decodeOctahedral(inNormal), 0.0);
+
+	// Pass bools specifying whether to use normal and opacity map
+	isCollided = lighting.isCollided;
+	useOpacityMap = lighting.useOpacityMap;
+	showAABB = lighting.showAABB;
+}